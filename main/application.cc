@@ -318,10 +318,12 @@ void Application::StopListening() {
 
     Schedule([this]() {
         if (device_state_ == kDeviceStateListening) {
+            // Audio still waiting for its batch must reach the server before the stop
+            SendQueuedAudio();
             protocol_->SendStopListening();
             SetDeviceState(kDeviceStateIdle);
         }
-    });
+    }, kMainTaskControl, 0, kMainTaskAfterQueued);
 }
 
 void Application::Start() {
@@ -380,13 +382,25 @@ void Application::Start() {
         last_error_message_ = message;
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
+    protocol_->SetPacketAllocator([this]() {
+        return audio_service_.AcquirePacket();
+    }, [this](std::unique_ptr<AudioStreamPacket> packet) {
+        audio_service_.ReleasePacket(std::move(packet));
+    });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
+        packet->origin_time_us = esp_timer_get_time();
         if (device_state_ == kDeviceStateSpeaking) {
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
+        } else {
+            audio_service_.ReleasePacket(std::move(packet));
         }
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
         board.SetPowerSaveMode(false);
+        auto uplink = protocol_->uplink_audio_params();
+        Schedule([this, uplink]() {
+            audio_service_.SetUplinkAudioParams(uplink);
+        }, kMainTaskAudio, MAIN_TASK_AUDIO_DEADLINE_MS);
         if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
             ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
                 protocol_->server_sample_rate(), codec->output_sample_rate());
@@ -394,101 +408,71 @@ void Application::Start() {
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
+        // Their results could not be sent anyway, MQTT keeps MCP on the control channel
+        if (protocol_->IsMcpOnAudioChannel()) {
+            McpServer::GetInstance().CancelToolCalls();
+        }
         Schedule([this]() {
+            audio_service_.SetUplinkAudioParams(UplinkAudioParams());
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
-        });
+        }, kMainTaskControl, 0, kMainTaskAfterQueued);
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
-                Schedule([this]() {
-                    aborted_ = false;
-                    if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
-                        SetDeviceState(kDeviceStateSpeaking);
-                    }
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    if (device_state_ == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
-                        }
-                    }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
-                }
-            }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
-                McpServer::GetInstance().ParseMessage(payload);
+    protocol_->OnIncomingJson([this, display](const JsonReader& root) {
+        // Dispatch on the members in place, only the MCP payload is parsed into a cJSON tree
+        auto type = root.Get("type");
+        ControlMessage control;
+        if (ParseControlMessage(root, control)) {
+            // tts / stt / llm, handled the same way as their binary form
+            OnControlMessage(control);
+        } else if (type.Equals("mcp")) {
+            auto payload = root.Get("payload");
+            if (payload.IsObject()) {
+                McpServer::GetInstance().ParseMessage(payload.data(), payload.length());
             }
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
+        } else if (type.Equals("system")) {
+            auto command = root.Get("command");
+            if (command.IsString()) {
+                ESP_LOGI(TAG, "System command: %.*s", (int)command.length(), command.data());
+                if (command.Equals("reboot")) {
                     // Do a reboot if user requests a OTA update
                     Schedule([this]() {
                         Reboot();
                     });
                 } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
+                    ESP_LOGW(TAG, "Unknown system command: %.*s", (int)command.length(), command.data());
                 }
             }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::P3_VIBRATION);
+        } else if (type.Equals("alert")) {
+            auto status = root.Get("status");
+            auto message = root.Get("message");
+            auto emotion = root.Get("emotion");
+            if (status.IsString() && message.IsString() && emotion.IsString()) {
+                Alert(status.ToString().c_str(), message.ToString().c_str(), emotion.ToString().c_str(), Lang::Sounds::P3_VIBRATION);
             } else {
                 ESP_LOGW(TAG, "Alert command requires status, message and emotion");
             }
 #if CONFIG_RECEIVE_CUSTOM_MESSAGE
-        } else if (strcmp(type->valuestring, "custom") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
-            if (cJSON_IsObject(payload)) {
-                Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
+        } else if (type.Equals("custom")) {
+            auto payload = root.Get("payload");
+            ESP_LOGI(TAG, "Received custom message: %.*s", (int)payload.length(), payload.data() ? payload.data() : "");
+            if (payload.IsObject()) {
+                // The raw payload text, no need to serialize it again
+                Schedule([this, display, payload_str = payload.ToString()]() {
                     display->SetChatMessage("system", payload_str.c_str());
-                });
+                }, kMainTaskUi, MAIN_TASK_UI_DEADLINE_MS);
             } else {
                 ESP_LOGW(TAG, "Invalid custom message format: missing payload");
             }
 #endif
         } else {
-            ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
+            ESP_LOGW(TAG, "Unknown message type: %.*s", (int)type.length(), type.data());
         }
     });
+    protocol_->OnIncomingControl([this](const ControlMessage& message) {
+        OnControlMessage(message);
+    });
     bool protocol_started = protocol_->Start();
 
     SetDeviceState(kDeviceStateIdle);
@@ -506,26 +490,132 @@ void Application::Start() {
     SystemInfo::PrintHeapStats();
 }
 
+void Application::OnControlMessage(const ControlMessage& message) {
+    auto display = Board::GetInstance().GetDisplay();
+    if (message.type == kControlTts) {
+        if (message.state == kControlTtsStart) {
+            Schedule([this]() {
+                aborted_ = false;
+                if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
+                    SetDeviceState(kDeviceStateSpeaking);
+                }
+            }, kMainTaskControl, 0, kMainTaskAfterQueued);
+        } else if (message.state == kControlTtsStop) {
+            Schedule([this]() {
+                if (device_state_ == kDeviceStateSpeaking) {
+                    if (listening_mode_ == kListeningModeManualStop) {
+                        SetDeviceState(kDeviceStateIdle);
+                    } else {
+                        SetDeviceState(kDeviceStateListening);
+                    }
+                }
+            }, kMainTaskControl, 0, kMainTaskAfterQueued);
+        } else if (message.state == kControlTtsSentenceStart && message.text.IsString()) {
+            auto text = message.text.ToString();
+            ESP_LOGI(TAG, "<< %s", text.c_str());
+            Schedule([this, display, text = std::move(text)]() {
+                display->SetChatMessage("assistant", text.c_str());
+            }, kMainTaskUi, MAIN_TASK_UI_DEADLINE_MS);
+        }
+    } else if (message.type == kControlStt) {
+        if (message.text.IsString()) {
+            auto text = message.text.ToString();
+            ESP_LOGI(TAG, ">> %s", text.c_str());
+            Schedule([this, display, text = std::move(text)]() {
+                display->SetChatMessage("user", text.c_str());
+            }, kMainTaskUi, MAIN_TASK_UI_DEADLINE_MS);
+        }
+    } else if (message.type == kControlLlm) {
+        if (message.text.IsString()) {
+            Schedule([this, display, emotion = message.text.ToString()]() {
+                display->SetEmotion(emotion.c_str());
+            }, kMainTaskUi, MAIN_TASK_UI_DEADLINE_MS);
+        }
+    } else {
+        ESP_LOGW(TAG, "Unexpected control message: %u", message.type);
+    }
+}
+
 void Application::OnClockTimer() {
     clock_ticks_++;
 
     auto display = Board::GetInstance().GetDisplay();
     display->UpdateStatusBar();
 
+#if CONFIG_WEBSOCKET_KEEP_WARM_SECONDS > 0
+    // Drop a warm standby connection once it has used up its time budget
+    if (device_state_ == kDeviceStateIdle) {
+        Schedule([this]() {
+            if (protocol_ && device_state_ == kDeviceStateIdle) {
+                protocol_->CoolDownAudioChannel(false);
+            }
+        });
+    }
+#endif
+
+    // Adapt the uplink Opus frames to the link quality and report the downlink quality
+    if (device_state_ == kDeviceStateListening || device_state_ == kDeviceStateSpeaking) {
+        Schedule([this]() {
+            if (protocol_ && protocol_->IsAudioChannelOpened()) {
+                audio_service_.AdaptUplink(protocol_->GetAudioLinkStats());
+                protocol_->SendAudioLinkReport();
+            }
+        }, kMainTaskAudio, MAIN_TASK_AUDIO_DEADLINE_MS);
+    }
+
     // Print the debug info every 10 seconds
     if (clock_ticks_ % 10 == 0) {
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
         // SystemInfo::PrintTaskList();
         SystemInfo::PrintHeapStats();
+        auto task_pool = audio_service_.GetTaskPoolStats();
+        auto packet_pool = audio_service_.GetPacketPoolStats();
+        ESP_LOGI(TAG, "Audio pools: task %u/%u peak, %lu misses; packet %u/%u peak, %lu misses",
+            task_pool.high_water, task_pool.capacity, task_pool.misses,
+            packet_pool.high_water, packet_pool.capacity, packet_pool.misses);
+        auto& encode = audio_service_.GetLatencyHistogram(kAudioLatencyEncode);
+        auto& encode_wait = audio_service_.GetLatencyHistogram(kAudioLatencyEncodeQueueWait);
+        auto& decode = audio_service_.GetLatencyHistogram(kAudioLatencyDecode);
+        ESP_LOGI(TAG, "Audio codec: encode p95 %dms max %lums, encode wait p95 %dms, decode p95 %dms max %lums",
+            encode.PercentileMs(95), encode.max_us() / 1000, encode_wait.PercentileMs(95),
+            decode.PercentileMs(95), decode.max_us() / 1000);
+        auto main_tasks = main_tasks_.GetStats();
+        auto& control = main_tasks_.GetExecutionHistogram(kMainTaskControl);
+        auto& ui_wait = main_tasks_.GetWaitHistogram(kMainTaskUi);
+        ESP_LOGI(TAG, "Main tasks: %u/%u peak, %lu overflows, %lu heap; control max %lums; ui wait p95 %dms, %lu late",
+            main_tasks.high_water, main_tasks.capacity, main_tasks.overflows, main_tasks.heap_tasks,
+            control.max_us() / 1000, ui_wait.PercentileMs(95), main_tasks.deadline_misses[kMainTaskUi]);
+        DisplayRefreshStats refresh;
+        if (Board::GetInstance().GetDisplay()->GetRefreshStats(refresh)) {
+            ESP_LOGI(TAG, "Display: %lu fps, %lu frames, render avg %lums max %lums p95 %dms, %lu idle pauses",
+                refresh.fps, refresh.frames, refresh.render_avg_us / 1000, refresh.render_max_us / 1000,
+                refresh.render_p95_ms, refresh.pauses);
+        }
     }
 }
 
-// Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        main_tasks_.push_back(std::move(callback));
+// Send everything in the audio send queue as one batch
+void Application::SendQueuedAudio() {
+    while (auto packet = audio_service_.PopPacketFromSendQueue()) {
+        send_batch_.push_back(std::move(packet));
+    }
+    if (send_batch_.empty()) {
+        return;
+    }
+
+    size_t sent = protocol_->SendAudioBatch(send_batch_);
+    for (size_t i = 0; i < send_batch_.size(); i++) {
+        if (i < sent) {
+            audio_service_.RecordPacketSent(*send_batch_[i]);
+        }
+        audio_service_.ReleasePacket(std::move(send_batch_[i]));
     }
+    send_batch_.clear();
+}
+
+// Add a async task to MainLoop, tasks of a higher priority class run first
+void Application::Schedule(MainTask callback, MainTaskPriority priority, uint32_t deadline_ms, MainTaskOrder order) {
+    main_tasks_.Push(std::move(callback), priority, deadline_ms, order);
     xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
 }
 
@@ -548,11 +638,7 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
-            while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (!protocol_->SendAudio(std::move(packet))) {
-                    break;
-                }
-            }
+            SendQueuedAudio();
         }
 
         if (bits & MAIN_EVENT_WAKE_WORD_DETECTED) {
@@ -567,11 +653,14 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SCHEDULE) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto tasks = std::move(main_tasks_);
-            lock.unlock();
-            for (auto& task : tasks) {
-                task();
+            // Run as many tasks as are queued now. A control task scheduled meanwhile overtakes
+            // queued UI tasks unless it changes what they paint, whatever is left sets the bit
+            // again and runs at the next wakeup
+            for (size_t pending = main_tasks_.Size(); pending > 0 && main_tasks_.RunNext(); pending--) {
+                // Keep the uplink flowing through a burst of tasks
+                if (xEventGroupClearBits(event_group_, MAIN_EVENT_SEND_AUDIO) & MAIN_EVENT_SEND_AUDIO) {
+                    SendQueuedAudio();
+                }
             }
         }
     }
@@ -583,23 +672,37 @@ void Application::OnWakeWordDetected() {
     }
 
     if (device_state_ == kDeviceStateIdle) {
+        // The pre-roll is encoded by the wake word's own task while the channel is set up
         audio_service_.EncodeWakeWord();
+        auto wake_word = audio_service_.GetLastWakeWord();
+        ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
 
         if (!protocol_->IsAudioChannelOpened()) {
+            // Capture what is said during the handshake, it waits in the send queue and its
+            // spill buffer until the channel is open
+            audio_service_.EnableWakeWordDetection(false);
+            audio_service_.EnableVoiceProcessing(true);
+            audio_service_.SetAudioChannelOpening(true);
             SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
+            bool opened = protocol_->OpenAudioChannel();
+            audio_service_.SetAudioChannelOpening(false);
+            if (!opened) {
+                audio_service_.EnableVoiceProcessing(false);
                 audio_service_.EnableWakeWordDetection(true);
                 return;
             }
         }
 
-        auto wake_word = audio_service_.GetLastWakeWord();
-        ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
 #if CONFIG_USE_AFE_WAKE_WORD || CONFIG_USE_CUSTOM_WAKE_WORD
-        // Encode and send the wake word data to the server
+        // Send the wake word data to the server as one burst
         while (auto packet = audio_service_.PopWakeWordPacket()) {
-            protocol_->SendAudio(std::move(packet));
+            send_batch_.push_back(std::move(packet));
+        }
+        protocol_->SendAudioBatch(send_batch_);
+        for (auto& packet : send_batch_) {
+            audio_service_.ReleasePacket(std::move(packet));
         }
+        send_batch_.clear();
         // Set the chat state to wake word detected
         protocol_->SendWakeWordDetected(wake_word);
         SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
@@ -608,6 +711,8 @@ void Application::OnWakeWordDetected() {
         // Play the pop up sound to indicate the wake word is detected
         audio_service_.PlaySound(Lang::Sounds::P3_POPUP);
 #endif
+        // Followed by the speech captured during the handshake
+        SendQueuedAudio();
     } else if (device_state_ == kDeviceStateSpeaking) {
         AbortSpeaking(kAbortReasonWakeWordDetected);
     } else if (device_state_ == kDeviceStateActivating) {
@@ -650,6 +755,7 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
+            KeepAudioChannelWarm(true);
             break;
         case kDeviceStateConnecting:
             display->SetStatus(Lang::Strings::CONNECTING);
@@ -660,10 +766,14 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
 
-            // Make sure the audio processor is running
-            if (!audio_service_.IsAudioProcessorRunning()) {
+            // Make sure the audio processor is running, it is already capturing if it was started
+            // while connecting after a wake word
+            if (!audio_service_.IsAudioProcessorRunning() || previous_state == kDeviceStateConnecting) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
+                audio_service_.SetSendBatchDuration(listening_mode_ == kListeningModeRealtime ? 0 : CONFIG_AUDIO_SEND_BATCH_MS);
+            }
+            if (!audio_service_.IsAudioProcessorRunning()) {
                 audio_service_.EnableVoiceProcessing(true);
                 audio_service_.EnableWakeWordDetection(false);
             }
@@ -731,6 +841,21 @@ bool Application::CanEnterSleepMode() {
     return true;
 }
 
+void Application::KeepAudioChannelWarm(bool warm) {
+#if CONFIG_WEBSOCKET_KEEP_WARM_SECONDS > 0
+    Schedule([this, warm]() {
+        if (!protocol_) {
+            return;
+        }
+        if (!warm) {
+            protocol_->CoolDownAudioChannel(true);
+        } else if (device_state_ == kDeviceStateIdle) {
+            protocol_->WarmUpAudioChannel();
+        }
+    });
+#endif
+}
+
 void Application::SendMcpMessage(const std::string& payload) {
     Schedule([this, payload]() {
         if (protocol_) {
@@ -8,7 +8,6 @@
 
 #include <string>
 #include <mutex>
-#include <deque>
 #include <vector>
 #include <memory>
 
@@ -16,6 +15,7 @@
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#include "main_task_queue.h"
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
 #define MAIN_EVENT_SEND_AUDIO (1 << 1)
@@ -24,6 +24,11 @@
 #define MAIN_EVENT_ERROR (1 << 4)
 #define MAIN_EVENT_CHECK_NEW_VERSION_DONE (1 << 5)
 
+#define MAIN_TASK_QUEUE_CAPACITY 32
+// A scheduled task that waits longer than this is counted as a deadline miss
+#define MAIN_TASK_AUDIO_DEADLINE_MS 100
+#define MAIN_TASK_UI_DEADLINE_MS 200
+
 enum AecMode {
     kAecOff,
     kAecOnDeviceSide,
@@ -44,7 +49,8 @@ public:
     void MainEventLoop();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
-    void Schedule(std::function<void()> callback);
+    void Schedule(MainTask callback, MainTaskPriority priority = kMainTaskControl, uint32_t deadline_ms = 0,
+        MainTaskOrder order = kMainTaskOvertake);
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -55,6 +61,7 @@ public:
     void Reboot();
     void WakeWordInvoke(const std::string& wake_word);
     bool CanEnterSleepMode();
+    void KeepAudioChannelWarm(bool warm);
     void SendMcpMessage(const std::string& payload);
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
@@ -65,8 +72,7 @@ private:
     Application();
     ~Application();
 
-    std::mutex mutex_;
-    std::deque<std::function<void()>> main_tasks_;
+    MainTaskQueue main_tasks_{MAIN_TASK_QUEUE_CAPACITY};
     std::unique_ptr<Protocol> protocol_;
     EventGroupHandle_t event_group_ = nullptr;
     esp_timer_handle_t clock_timer_handle_ = nullptr;
@@ -80,12 +86,15 @@ private:
     bool aborted_ = false;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
+    std::vector<std::unique_ptr<AudioStreamPacket>> send_batch_;
 
     void OnWakeWordDetected();
     void CheckNewVersion(Ota& ota);
     void ShowActivationCode(const std::string& code, const std::string& message);
     void OnClockTimer();
+    void OnControlMessage(const ControlMessage& message);
     void SetListeningMode(ListeningMode mode);
+    void SendQueuedAudio();
 };
 
 #endif // _APPLICATION_H_
@@ -0,0 +1,104 @@
+#include "audio_channels.h"
+
+/* Two packed samples, the low half is the earlier one */
+typedef uint32_t __attribute__((may_alias)) sample_pair_t;
+
+static inline bool IsAligned(const void* pointer) {
+    return ((uintptr_t)pointer & 3) == 0;
+}
+
+void SplitStereo(const int16_t* input, int16_t* left, int16_t* right, size_t frames) {
+    size_t i = 0;
+    if (IsAligned(input) && IsAligned(left) && IsAligned(right)) {
+        auto in = (const sample_pair_t*)input;
+        auto out_left = (sample_pair_t*)left;
+        auto out_right = (sample_pair_t*)right;
+        for (size_t pairs = frames / 2; i < pairs; i++) {
+            uint32_t a = in[2 * i];
+            uint32_t b = in[2 * i + 1];
+            out_left[i] = (a & 0xffff) | (b << 16);
+            out_right[i] = (a >> 16) | (b & 0xffff0000);
+        }
+        i *= 2;
+    }
+    for (; i < frames; i++) {
+        left[i] = input[2 * i];
+        right[i] = input[2 * i + 1];
+    }
+}
+
+void MergeStereo(const int16_t* left, const int16_t* right, int16_t* output, size_t frames) {
+    size_t i = 0;
+    if (IsAligned(left) && IsAligned(right) && IsAligned(output)) {
+        auto in_left = (const sample_pair_t*)left;
+        auto in_right = (const sample_pair_t*)right;
+        auto out = (sample_pair_t*)output;
+        for (size_t pairs = frames / 2; i < pairs; i++) {
+            uint32_t l = in_left[i];
+            uint32_t r = in_right[i];
+            out[2 * i] = (l & 0xffff) | (r << 16);
+            out[2 * i + 1] = (l >> 16) | (r & 0xffff0000);
+        }
+        i *= 2;
+    }
+    for (; i < frames; i++) {
+        output[2 * i] = left[i];
+        output[2 * i + 1] = right[i];
+    }
+}
+
+void ExtractChannel(const int16_t* input, int16_t* output, size_t frames, int channels, int channel) {
+    size_t i = 0;
+    if (channels == 2 && IsAligned(input) && IsAligned(output)) {
+        // Output word i only depends on input words 2i and 2i+1, so this also works in place
+        auto in = (const sample_pair_t*)input;
+        auto out = (sample_pair_t*)output;
+        for (size_t pairs = frames / 2; i < pairs; i++) {
+            uint32_t a = in[2 * i];
+            uint32_t b = in[2 * i + 1];
+            out[i] = channel == 0 ? (a & 0xffff) | (b << 16) : (a >> 16) | (b & 0xffff0000);
+        }
+        i *= 2;
+    }
+    for (; i < frames; i++) {
+        output[i] = input[i * channels + channel];
+    }
+}
+
+void ScaleToInt32(const int16_t* input, int32_t* output, size_t samples, int32_t factor) {
+    // With factor <= 65536 the product stays within [INT32_MIN, INT32_MAX], so no 64-bit math or clamp
+    if (factor < 0) {
+        factor = 0;
+    } else if (factor > 65536) {
+        factor = 65536;
+    }
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        output[i] = input[i] * factor;
+        output[i + 1] = input[i + 1] * factor;
+        output[i + 2] = input[i + 2] * factor;
+        output[i + 3] = input[i + 3] * factor;
+    }
+    for (; i < samples; i++) {
+        output[i] = input[i] * factor;
+    }
+}
+
+static inline int16_t SaturateToInt16(int32_t value) {
+    value = value > INT16_MAX ? INT16_MAX : value;
+    value = value < -INT16_MAX ? -INT16_MAX : value;
+    return (int16_t)value;
+}
+
+void ConvertToInt16(const int32_t* input, int16_t* output, size_t samples, int shift) {
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        output[i] = SaturateToInt16(input[i] >> shift);
+        output[i + 1] = SaturateToInt16(input[i + 1] >> shift);
+        output[i + 2] = SaturateToInt16(input[i + 2] >> shift);
+        output[i + 3] = SaturateToInt16(input[i + 3] >> shift);
+    }
+    for (; i < samples; i++) {
+        output[i] = SaturateToInt16(input[i] >> shift);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef AUDIO_CHANNELS_H
+#define AUDIO_CHANNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Channel split / merge and sample format kernels for 16-bit PCM.
+ *
+ * When the buffers are 4-byte aligned (std::vector storage always is), the channel kernels move two samples
+ * with each 32-bit load and store, which halves the memory operations of a per-sample loop.
+ * The remainder and unaligned buffers fall back to the per-sample loop. Little-endian only.
+ */
+
+/* Splits `frames` stereo frames into two mono buffers */
+void SplitStereo(const int16_t* input, int16_t* left, int16_t* right, size_t frames);
+
+/* Interleaves two mono buffers into `frames` stereo frames */
+void MergeStereo(const int16_t* left, const int16_t* right, int16_t* output, size_t frames);
+
+/* Keeps `channel` of `frames` interleaved frames, output may be the same buffer as input */
+void ExtractChannel(const int16_t* input, int16_t* output, size_t frames, int channels, int channel);
+
+/* Scales 16-bit samples into the top bits of 32-bit I2S slots, `factor` is 0-65536 (unity) */
+void ScaleToInt32(const int16_t* input, int32_t* output, size_t samples, int32_t factor);
+
+/* Converts 32-bit I2S slots to 16-bit samples: shift right by `shift`, saturate to +-INT16_MAX */
+void ConvertToInt16(const int32_t* input, int16_t* output, size_t samples, int shift);
+
+#endif // AUDIO_CHANNELS_H
@@ -1,5 +1,9 @@
 #include "audio_service.h"
+#include "audio_channels.h"
 #include <esp_log.h>
+#include <algorithm>
+#include <cJSON.h>
+#include <arpa/inet.h>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -17,12 +21,34 @@
 
 #define TAG "AudioService"
 
+static const char* const LATENCY_STAGE_NAMES[] = {
+    "capture_to_processed",
+    "encode_queue_wait",
+    "encode",
+    "send_queue_wait",
+    "capture_to_send",
+    "decode_queue_wait",
+    "decode",
+    "playback_queue_wait",
+    "i2s_write",
+    "receive_to_playback",
+};
+static_assert(sizeof(LATENCY_STAGE_NAMES) / sizeof(LATENCY_STAGE_NAMES[0]) == kAudioLatencyStageCount);
+
+static inline BaseType_t TaskCoreId(int core) {
+    return core < 0 ? tskNO_AFFINITY : core;
+}
+
 
 AudioService::AudioService() {
     event_group_ = xEventGroupCreate();
 }
 
 AudioService::~AudioService() {
+    if (audio_power_timer_ != nullptr) {
+        esp_timer_stop(audio_power_timer_);
+        esp_timer_delete(audio_power_timer_);
+    }
     if (event_group_ != nullptr) {
         vEventGroupDelete(event_group_);
     }
@@ -43,6 +69,13 @@ void AudioService::Initialize(AudioCodec* codec) {
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
     }
 
+    /* Allocate the frame pools up front, before the heap gets fragmented */
+    size_t max_frame_samples = std::max(16000, codec->output_sample_rate()) * OPUS_FRAME_DURATION_MS / 1000;
+    task_pool_.Prewarm([max_frame_samples](AudioTask& task) {
+        task.pcm.reserve(max_frame_samples);
+    });
+    packet_pool_.Prewarm();
+
 #if CONFIG_USE_AUDIO_PROCESSOR
     audio_processor_ = std::make_unique<AfeAudioProcessor>();
 #else
@@ -60,7 +93,8 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
-        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
+        int64_t capture_time = EstimateCaptureTime(data.size());
+        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data), capture_time);
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
@@ -127,12 +161,20 @@ void AudioService::Start() {
     }, "audio_output", 2048, this, 3, &audio_output_task_handle_);
 #endif
 
-    /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    /* Start the opus encoder and decoder tasks, kept off the core used by the audio input / AFE task */
+    xTaskCreatePinnedToCore([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
-        audio_service->OpusCodecTask();
+        audio_service->OpusEncodeTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, "opus_encode", 2048 * 13, this, CONFIG_AUDIO_ENCODE_TASK_PRIORITY, &opus_encode_task_handle_,
+        TaskCoreId(CONFIG_AUDIO_ENCODE_TASK_CORE));
+
+    xTaskCreatePinnedToCore([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusDecodeTask();
+        vTaskDelete(NULL);
+    }, "opus_decode", 2048 * 8, this, CONFIG_AUDIO_DECODE_TASK_PRIORITY, &opus_decode_task_handle_,
+        TaskCoreId(CONFIG_AUDIO_DECODE_TASK_CORE));
 }
 
 void AudioService::Stop() {
@@ -142,12 +184,23 @@ void AudioService::Stop() {
         AS_EVENT_WAKE_WORD_RUNNING |
         AS_EVENT_AUDIO_PROCESSOR_RUNNING);
 
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    audio_encode_queue_.Clear();
+    audio_decode_queue_.Clear();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    NotifyAudioTasks();
+}
+
+void AudioService::NotifyAudioTasks() {
+    if (audio_output_task_handle_ != nullptr) {
+        xTaskNotifyGive(audio_output_task_handle_);
+    }
+    if (opus_encode_task_handle_ != nullptr) {
+        xTaskNotifyGive(opus_encode_task_handle_);
+    }
+    if (opus_decode_task_handle_ != nullptr) {
+        xTaskNotifyGive(opus_decode_task_handle_);
+    }
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
@@ -162,25 +215,19 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
             return false;
         }
         if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
+            mic_channel_.resize(data.size() / 2);
+            reference_channel_.resize(data.size() / 2);
+            SplitStereo(data.data(), mic_channel_.data(), reference_channel_.data(), mic_channel_.size());
+            resampled_mic_.resize(input_resampler_.GetOutputSamples(mic_channel_.size()));
+            resampled_reference_.resize(reference_resampler_.GetOutputSamples(reference_channel_.size()));
+            input_resampler_.Process(mic_channel_.data(), mic_channel_.size(), resampled_mic_.data());
+            reference_resampler_.Process(reference_channel_.data(), reference_channel_.size(), resampled_reference_.data());
+            data.resize(resampled_mic_.size() + resampled_reference_.size());
+            MergeStereo(resampled_mic_.data(), resampled_reference_.data(), data.data(), resampled_mic_.size());
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            resampled_mic_.resize(input_resampler_.GetOutputSamples(data.size()));
+            input_resampler_.Process(data.data(), data.size(), resampled_mic_.data());
+            data.swap(resampled_mic_);
         }
     } else {
         data.resize(samples);
@@ -205,6 +252,9 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 }
 
 void AudioService::AudioInputTask() {
+    /* Reused for every frame; the encode queue swaps a pooled buffer back into it */
+    auto& data = input_buffer_;
+
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
             AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
@@ -221,30 +271,27 @@ void AudioService::AudioInputTask() {
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+            int frame_duration = uplink_frame_duration_ms_;
+            int max_packets = std::min(AUDIO_TESTING_MAX_DURATION_MS / frame_duration, TESTING_RING_CAPACITY);
+            if (audio_testing_queue_.Size() >= (size_t)max_packets) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
                 continue;
             }
-            std::vector<int16_t> data;
-            int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
+            int samples = frame_duration * 16000 / 1000;
             if (ReadAudioData(data, 16000, samples)) {
                 // If input channels is 2, we need to fetch the left channel data
                 if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
+                    ExtractChannel(data.data(), data.data(), data.size() / 2, 2, 0);
+                    data.resize(data.size() / 2);
                 }
-                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
+                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data), esp_timer_get_time());
                 continue;
             }
         }
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
@@ -256,10 +303,12 @@ void AudioService::AudioInputTask() {
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+                    /* Advance the capture clock before feeding, the processor may output synchronously */
+                    last_capture_time_us_ = esp_timer_get_time();
+                    captured_samples_ += data.size() / codec_->input_channels();
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -274,17 +323,21 @@ void AudioService::AudioInputTask() {
 }
 
 void AudioService::AudioOutputTask() {
+    audio_playback_queue_.SetConsumerTask(xTaskGetCurrentTaskHandle());
+    timestamp_queue_.SetProducerTask(xTaskGetCurrentTaskHandle());
+
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
         if (service_stopped_) {
             break;
         }
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
+        std::unique_ptr<AudioTask> task;
+        if (!audio_playback_queue_.Pop(task)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        int64_t start_time = esp_timer_get_time();
+        latency_histograms_[kAudioLatencyPlaybackQueueWait].Record(start_time - task->stage_time_us);
 
         if (!codec_->output_enabled()) {
             codec_->EnableOutput(true);
@@ -292,6 +345,12 @@ void AudioService::AudioOutputTask() {
         }
         codec_->OutputData(task->pcm);
 
+        int64_t end_time = esp_timer_get_time();
+        latency_histograms_[kAudioLatencyI2sWrite].Record(end_time - start_time);
+        if (task->origin_time_us > 0) {
+            latency_histograms_[kAudioLatencyReceiveToPlayback].Record(end_time - task->origin_time_us);
+        }
+
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
         debug_statistics_.playback_count++;
@@ -299,92 +358,202 @@ void AudioService::AudioOutputTask() {
 #if CONFIG_USE_SERVER_AEC
         /* Record the timestamp for server AEC */
         if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
+            uint32_t timestamp = task->timestamp;
+            // A full queue means nothing is being encoded, so there is no frame to stamp
+            timestamp_queue_.Push(std::move(timestamp));
         }
 #endif
+        task_pool_.Release(std::move(task));
     }
 
+    audio_playback_queue_.SetConsumerTask(nullptr);
+    timestamp_queue_.SetProducerTask(nullptr);
     ESP_LOGW(TAG, "Audio output task stopped");
 }
 
-void AudioService::OpusCodecTask() {
+void AudioService::OpusDecodeTask() {
+    audio_decode_queue_.SetConsumerTask(xTaskGetCurrentTaskHandle());
+    audio_playback_queue_.SetProducerTask(xTaskGetCurrentTaskHandle());
+
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
-            return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
-        });
         if (service_stopped_) {
             break;
         }
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
+        if (jitter_buffer_reset_.exchange(false)) {
+            jitter_buffer_.Reset();
+        }
 
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
+        /* Move the arrived packets into the jitter buffer, which puts them back in order */
+        std::unique_ptr<AudioStreamPacket> packet;
+        while (!jitter_buffer_.Full() && audio_decode_queue_.Pop(packet)) {
+            jitter_buffer_.Push(std::move(packet), esp_timer_get_time());
+        }
+
+        /* Sleep until a packet arrives or the output task frees a playback slot */
+        if (audio_playback_queue_.Size() >= MAX_PLAYBACK_TASKS_IN_QUEUE) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
 
+        int64_t start_time = esp_timer_get_time();
+        int64_t wait_us = 0;
+        auto result = jitter_buffer_.Pop(start_time, packet, wait_us);
+        {
+            std::lock_guard<std::mutex> lock(jitter_stats_mutex_);
+            jitter_stats_ = jitter_buffer_.stats();
+        }
+        if (result == kJitterBufferEmpty) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        } else if (result == kJitterBufferWait) {
+            // Rounded up to whole ticks, pdMS_TO_TICKS would truncate short waits to 0 at 100 Hz
+            TickType_t ticks = (wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+            ulTaskNotifyTake(pdTRUE, std::max<TickType_t>(1, ticks));
+            continue;
+        }
+
+        auto task = AcquireTask(kAudioTaskTypeDecodeToPlaybackQueue);
+        bool decoded;
+        if (result == kJitterBufferPacket) {
+            latency_histograms_[kAudioLatencyDecodeQueueWait].Record(start_time - packet->stage_time_us);
+            task->timestamp = packet->timestamp;
+            task->origin_time_us = packet->origin_time_us;
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
-                }
+            decoded = opus_decoder_->Decode(std::move(packet->payload), task->pcm);
+            packet_pool_.Release(std::move(packet));
+        } else {
+            // Lost frame, an empty payload makes the Opus decoder run its packet loss concealment
+            std::vector<uint8_t> empty;
+            decoded = opus_decoder_->Decode(std::move(empty), task->pcm);
+        }
 
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
-            } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
+        if (decoded) {
+            // Resample if the sample rate is different
+            if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+                int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
+                output_resample_buffer_.resize(target_size);
+                output_resampler_.Process(task->pcm.data(), task->pcm.size(), output_resample_buffer_.data());
+                task->pcm.swap(output_resample_buffer_);
             }
-            debug_statistics_.decode_count++;
-        }
-        
-        /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
-            auto task = std::move(audio_encode_queue_.front());
-            audio_encode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-                continue;
+            task->stage_time_us = esp_timer_get_time();
+            if (!audio_playback_queue_.Push(std::move(task))) {
+                task_pool_.Release(std::move(task));
             }
+        } else {
+            ESP_LOGE(TAG, "Failed to decode audio");
+            task_pool_.Release(std::move(task));
+        }
+        latency_histograms_[kAudioLatencyDecode].Record(esp_timer_get_time() - start_time);
+        debug_statistics_.decode_count++;
+    }
 
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
+    jitter_buffer_.Reset();
+    audio_decode_queue_.SetConsumerTask(nullptr);
+    audio_playback_queue_.SetProducerTask(nullptr);
+    ESP_LOGW(TAG, "Opus decode task stopped");
+}
+
+void AudioService::OpusEncodeTask() {
+    audio_encode_queue_.SetConsumerTask(xTaskGetCurrentTaskHandle());
+    audio_send_queue_.SetProducerTask(xTaskGetCurrentTaskHandle());
+
+    while (true) {
+        if (service_stopped_) {
+            break;
+        }
+
+        /* Sleep until a PCM frame arrives or the main loop drains the send queue */
+        std::unique_ptr<AudioTask> task;
+        if (IsSendQueueFull() || !audio_encode_queue_.Pop(task)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        int64_t start_time = esp_timer_get_time();
+        latency_histograms_[kAudioLatencyEncodeQueueWait].Record(start_time - task->stage_time_us);
+
+        /* Follow the uplink parameters negotiated with the server or picked by AdaptUplink */
+        int frame_duration = uplink_frame_duration_ms_;
+        if (opus_encoder_->duration_ms() != frame_duration) {
+            ESP_LOGI(TAG, "Uplink Opus frame duration: %d -> %d ms", opus_encoder_->duration_ms(), frame_duration);
+            opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, frame_duration);
+            opus_encoder_->SetComplexity(0);
+            encoder_dtx_ = false;
+        }
+        if (encoder_dtx_ != uplink_dtx_) {
+            encoder_dtx_ = uplink_dtx_;
+            opus_encoder_->SetDtx(encoder_dtx_);
+        }
+
+        auto type = task->type;
+        uint32_t timestamp = task->timestamp;
+        int64_t origin_time_us = task->origin_time_us;
+        int encoded_frames = 0;
+        auto output_packet = [&](std::unique_ptr<AudioStreamPacket> packet) {
+            packet->frame_duration = frame_duration;
+            packet->sample_rate = 16000;
+            packet->timestamp = timestamp + encoded_frames * frame_duration;
+            packet->origin_time_us = origin_time_us;
+            packet->stage_time_us = esp_timer_get_time();
+            encoded_frames++;
+            if (type == kAudioTaskTypeEncodeToSendQueue) {
+                // Once packets spill, the following ones do too until the spill is drained, so
+                // the main loop gets them in order
+                bool spill = !send_spill_.Empty() || audio_send_queue_.Size() >= MAX_SEND_PACKETS_IN_QUEUE;
+                if (spill && send_spill_.Push(*packet)) {
+                    packet_pool_.Release(std::move(packet));
+                } else if (!audio_send_queue_.Push(std::move(packet))) {
+                    ESP_LOGW(TAG, "Send queue is full, dropping packet");
+                    packet_pool_.Release(std::move(packet));
+                }
+                size_t depth = audio_send_queue_.Size();
+                if (depth > send_queue_peak_) {
+                    send_queue_peak_ = depth;
                 }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
+                // Coalesce the main loop wakeups, but flush right away once voice processing stops
+                pending_send_ms_ += frame_duration;
+                if (pending_send_ms_ >= send_batch_ms_ || !IsAudioProcessorRunning()) {
+                    pending_send_ms_ = 0;
+                    if (callbacks_.on_send_queue_available) {
+                        callbacks_.on_send_queue_available();
+                    }
+                }
+            } else if (type == kAudioTaskTypeEncodeToTestingQueue) {
+                if (!audio_testing_queue_.Push(std::move(packet))) {
+                    packet_pool_.Release(std::move(packet));
                 }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
             }
             debug_statistics_.encode_count++;
-            lock.lock();
+        };
+
+        if (task->pcm.size() == (size_t)(16000 * frame_duration / 1000) && opus_encoder_->IsBufferEmpty()) {
+            auto packet = AcquirePacket();
+            bool encoded = opus_encoder_->Encode(std::move(task->pcm), packet->payload);
+            task_pool_.Release(std::move(task));
+            if (!encoded) {
+                ESP_LOGE(TAG, "Failed to encode audio");
+                packet_pool_.Release(std::move(packet));
+                continue;
+            }
+            output_packet(std::move(packet));
+        } else {
+            /* The frame was captured before a frame duration change, let the encoder re-frame it */
+            opus_encoder_->Encode(std::move(task->pcm), [&](std::vector<uint8_t>&& opus) {
+                auto packet = AcquirePacket();
+                packet->payload = std::move(opus);
+                output_packet(std::move(packet));
+            });
+            task_pool_.Release(std::move(task));
+        }
+        if (encoded_frames > 0) {
+            latency_histograms_[kAudioLatencyEncode].Record(esp_timer_get_time() - start_time);
         }
     }
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+    audio_encode_queue_.SetConsumerTask(nullptr);
+    audio_send_queue_.SetProducerTask(nullptr);
+    ESP_LOGW(TAG, "Opus encode task stopped");
 }
 
 void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
@@ -395,61 +564,208 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     opus_decoder_.reset();
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
 
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+    if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec_->output_sample_rate());
+        output_resampler_.Configure(opus_decoder_->sample_rate(), codec_->output_sample_rate());
     }
 }
 
-void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
-    auto task = std::make_unique<AudioTask>();
+std::unique_ptr<AudioTask> AudioService::AcquireTask(AudioTaskType type) {
+    auto task = task_pool_.Acquire();
     task->type = type;
-    task->pcm = std::move(pcm);
-    
-    /* Push the task to the encode queue */
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+    task->timestamp = 0;
+    task->origin_time_us = 0;
+    task->stage_time_us = 0;
+    task->pcm.clear();
+    return task;
+}
+
+std::unique_ptr<AudioStreamPacket> AudioService::AcquirePacket() {
+    auto packet = packet_pool_.Acquire();
+    packet->sample_rate = 0;
+    packet->frame_duration = 0;
+    packet->timestamp = 0;
+    packet->sequence = 0;
+    packet->origin_time_us = 0;
+    packet->stage_time_us = 0;
+    packet->payload.clear();
+    return packet;
+}
+
+void AudioService::ReleasePacket(std::unique_ptr<AudioStreamPacket> packet) {
+    packet_pool_.Release(std::move(packet));
+}
+
+int64_t AudioService::EstimateCaptureTime(size_t samples) {
+    /* The frame starts `backlog` samples before the newest captured sample (16 samples per ms) */
+    uint32_t first_sample = processed_samples_.fetch_add(samples);
+    int32_t backlog = captured_samples_.load() - first_sample;
+    return last_capture_time_us_.load() - (int64_t)backlog * 1000 / 16;
+}
+
+void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, int64_t capture_time_us) {
+    /* The audio processor output (AFE task) and audio testing (input task) both produce here,
+       and both consume the timestamp queue, so they take turns */
+    std::lock_guard<std::mutex> lock(encode_producer_mutex_);
+    auto task = AcquireTask(type);
+    task->origin_time_us = capture_time_us;
+    /* Swap instead of move, so the caller gets the pooled buffer back for its next frame */
+    task->pcm.swap(pcm);
 
     /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        size_t pending = timestamp_queue_.Size();
+        uint32_t timestamp;
+        if (timestamp_queue_.Pop(timestamp)) {
+            if (pending <= MAX_TIMESTAMPS_IN_QUEUE) {
+                task->timestamp = timestamp;
+            } else {
+                ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", pending);
+            }
         }
-        timestamp_queue_.pop_front();
     }
 
-    audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
-    audio_encode_queue_.push_back(std::move(task));
-    audio_queue_cv_.notify_all();
+    /* Push the task to the encode queue, waiting for the codec task to make room */
+    if (audio_encode_queue_.Size() >= MAX_ENCODE_TASKS_IN_QUEUE) {
+        audio_encode_queue_.SetProducerTask(xTaskGetCurrentTaskHandle());
+        while (audio_encode_queue_.Size() >= MAX_ENCODE_TASKS_IN_QUEUE && !service_stopped_) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        audio_encode_queue_.SetProducerTask(nullptr);
+    }
+    task->stage_time_us = esp_timer_get_time();
+    latency_histograms_[kAudioLatencyCaptureToProcessed].Record(task->stage_time_us - capture_time_us);
+    if (service_stopped_ || !audio_encode_queue_.Push(std::move(task))) {
+        task_pool_.Release(std::move(task));
+    }
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
-        if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
-        } else {
+    packet->stage_time_us = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(decode_producer_mutex_);
+    if (audio_decode_queue_.Size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
+        if (!wait) {
+            packet_pool_.Release(std::move(packet));
             return false;
         }
+        audio_decode_queue_.SetProducerTask(xTaskGetCurrentTaskHandle());
+        while (audio_decode_queue_.Size() >= MAX_DECODE_PACKETS_IN_QUEUE && !service_stopped_) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        audio_decode_queue_.SetProducerTask(nullptr);
+    }
+    if (!audio_decode_queue_.Push(std::move(packet))) {
+        packet_pool_.Release(std::move(packet));
+        return false;
     }
-    audio_decode_queue_.push_back(std::move(packet));
-    audio_queue_cv_.notify_all();
     return true;
 }
 
+void AudioService::RecordPacketSent(const AudioStreamPacket& packet) {
+    if (packet.origin_time_us == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    latency_histograms_[kAudioLatencySendQueueWait].Record(now - packet.stage_time_us);
+    latency_histograms_[kAudioLatencyCaptureToSend].Record(now - packet.origin_time_us);
+}
+
+JitterBufferStats AudioService::GetJitterBufferStats() {
+    std::lock_guard<std::mutex> lock(jitter_stats_mutex_);
+    return jitter_stats_;
+}
+
+std::string AudioService::GetLatencyJson() {
+    auto root = cJSON_CreateObject();
+    auto limits = cJSON_CreateArray();
+    for (auto limit : LatencyHistogram::kBucketLimitsMs) {
+        cJSON_AddItemToArray(limits, cJSON_CreateNumber(limit));
+    }
+    cJSON_AddItemToObject(root, "bucket_limits_ms", limits);
+
+    auto stages = cJSON_CreateObject();
+    for (int i = 0; i < kAudioLatencyStageCount; i++) {
+        auto& histogram = latency_histograms_[i];
+        auto stage = cJSON_CreateObject();
+        cJSON_AddNumberToObject(stage, "count", histogram.count());
+        cJSON_AddNumberToObject(stage, "avg_ms", histogram.average_us() / 1000.0);
+        cJSON_AddNumberToObject(stage, "p50_ms", histogram.PercentileMs(50));
+        cJSON_AddNumberToObject(stage, "p95_ms", histogram.PercentileMs(95));
+        cJSON_AddNumberToObject(stage, "max_ms", histogram.max_us() / 1000.0);
+        auto buckets = cJSON_CreateArray();
+        for (size_t j = 0; j < LatencyHistogram::kBucketCount; j++) {
+            cJSON_AddItemToArray(buckets, cJSON_CreateNumber(histogram.bucket(j)));
+        }
+        cJSON_AddItemToObject(stage, "buckets", buckets);
+        cJSON_AddItemToObject(stages, LATENCY_STAGE_NAMES[i], stage);
+    }
+    cJSON_AddItemToObject(root, "stages", stages);
+
+    auto jitter_stats = GetJitterBufferStats();
+    auto jitter = cJSON_CreateObject();
+    cJSON_AddNumberToObject(jitter, "jitter_ms", jitter_stats.jitter_us / 1000.0);
+    cJSON_AddNumberToObject(jitter, "target_depth", jitter_stats.target_depth);
+    cJSON_AddNumberToObject(jitter, "depth", jitter_stats.depth);
+    cJSON_AddNumberToObject(jitter, "received", jitter_stats.received);
+    cJSON_AddNumberToObject(jitter, "reordered", jitter_stats.reordered);
+    cJSON_AddNumberToObject(jitter, "late", jitter_stats.late);
+    cJSON_AddNumberToObject(jitter, "duplicated", jitter_stats.duplicated);
+    cJSON_AddNumberToObject(jitter, "lost", jitter_stats.lost);
+    cJSON_AddNumberToObject(jitter, "concealed", jitter_stats.concealed);
+    cJSON_AddItemToObject(root, "jitter_buffer", jitter);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void AudioService::ResetLatencyHistograms() {
+    for (auto& histogram : latency_histograms_) {
+        histogram.Reset();
+    }
+}
+
 std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    if (audio_send_queue_.empty()) {
+    std::unique_ptr<AudioStreamPacket> packet;
+    if (audio_send_queue_.Pop(packet) || send_spill_.Empty()) {
+        return packet;
+    }
+
+    /* The send queue is drained, continue with the packets that spilled over */
+    packet = AcquirePacket();
+    if (!send_spill_.Pop(*packet)) {
+        packet_pool_.Release(std::move(packet));
         return nullptr;
     }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
-    audio_queue_cv_.notify_all();
+    if (send_spill_.Empty() && !audio_channel_opening_) {
+        send_spill_.ReleaseIfEmpty();
+    }
+    if (opus_encode_task_handle_ != nullptr) {
+        xTaskNotifyGive(opus_encode_task_handle_);
+    }
     return packet;
 }
 
+bool AudioService::IsSendQueueFull() const {
+    if (send_spill_.Empty() && audio_send_queue_.Size() < MAX_SEND_PACKETS_IN_QUEUE) {
+        return false;
+    }
+    /* Only allocated while the audio channel opens, or until what spilled then is sent */
+    return !send_spill_.HasRoom(SEND_SPILL_MIN_ROOM);
+}
+
+void AudioService::SetAudioChannelOpening(bool opening) {
+    audio_channel_opening_ = opening;
+    if (!opening) {
+        send_spill_.ReleaseIfEmpty();
+    } else if (!send_spill_.Allocate(SEND_SPILL_SPIRAM_SIZE, SEND_SPILL_INTERNAL_SIZE)) {
+        ESP_LOGW(TAG, "No memory for the send spill, speech beyond %d packets waits for the channel",
+            MAX_SEND_PACKETS_IN_QUEUE);
+    }
+}
+
 void AudioService::EncodeWakeWord() {
     if (wake_word_) {
         wake_word_->EncodeWakeWordData();
@@ -461,10 +777,11 @@ const std::string& AudioService::GetLastWakeWord() const {
 }
 
 std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
-    auto packet = std::make_unique<AudioStreamPacket>();
+    auto packet = AcquirePacket();
     if (wake_word_->GetWakeWordOpus(packet->payload)) {
         return packet;
     }
+    packet_pool_.Release(std::move(packet));
     return nullptr;
 }
 
@@ -494,18 +811,26 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!audio_processor_initialized_) {
-            audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS);
+            audio_processor_->Initialize(codec_, uplink_frame_duration_ms_);
             audio_processor_initialized_ = true;
         }
 
-        /* We should make sure no audio is playing */
+        /* We should make sure no audio is playing, and no packet of a previous session gets sent */
         ResetDecoder();
+        audio_send_queue_.Clear();
+        send_spill_.Clear();
         audio_input_need_warmup_ = true;
+        /* The processor drops its buffered samples when stopped, so resync the capture clock */
+        processed_samples_ = captured_samples_.load();
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
         audio_processor_->Stop();
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+        /* Flush a partial send batch */
+        if ((audio_send_queue_.Size() > 0 || !send_spill_.Empty()) && callbacks_.on_send_queue_available) {
+            callbacks_.on_send_queue_available();
+        }
     }
 }
 
@@ -515,17 +840,22 @@ void AudioService::EnableAudioTesting(bool enable) {
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
-        audio_queue_cv_.notify_all();
+        /* Move audio_testing_queue_ to audio_decode_queue_ */
+        std::lock_guard<std::mutex> lock(decode_producer_mutex_);
+        audio_decode_queue_.Clear();
+        std::unique_ptr<AudioStreamPacket> packet;
+        while (audio_testing_queue_.Pop(packet)) {
+            if (!audio_decode_queue_.Push(std::move(packet))) {
+                packet_pool_.Release(std::move(packet));
+            }
+        }
     }
 }
 
 void AudioService::EnableDeviceAec(bool enable) {
     ESP_LOGI(TAG, "%s device AEC", enable ? "Enabling" : "Disabling");
     if (!audio_processor_initialized_) {
-        audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS);
+        audio_processor_->Initialize(codec_, uplink_frame_duration_ms_);
         audio_processor_initialized_ = true;
     }
 
@@ -544,11 +874,10 @@ void AudioService::PlaySound(const std::string_view& sound) {
         p += sizeof(BinaryProtocol3);
 
         auto payload_size = ntohs(p3->payload_size);
-        auto packet = std::make_unique<AudioStreamPacket>();
+        auto packet = AcquirePacket();
         packet->sample_rate = 16000;
         packet->frame_duration = 60;
-        packet->payload.resize(payload_size);
-        memcpy(packet->payload.data(), p3->payload, payload_size);
+        packet->payload.assign(p3->payload, p3->payload + payload_size);
         p += payload_size;
 
         PushPacketToDecodeQueue(std::move(packet), true);
@@ -556,18 +885,67 @@ void AudioService::PlaySound(const std::string_view& sound) {
 }
 
 bool AudioService::IsIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.Empty() && audio_decode_queue_.Empty() && audio_playback_queue_.Empty() && audio_testing_queue_.Empty();
 }
 
 void AudioService::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    timestamp_queue_.Clear();
+    jitter_buffer_reset_ = true;
+    audio_decode_queue_.Clear();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+}
+
+void AudioService::SetUplinkAudioParams(const UplinkAudioParams& params) {
+    uplink_params_ = params;
+    last_link_stats_ = AudioLinkStats();
+    healthy_intervals_ = 0;
+    send_queue_peak_ = 0;
+    uplink_dtx_ = params.dtx;
+    uplink_frame_duration_ms_ = params.frame_duration;
+    audio_processor_->SetFrameDuration(params.frame_duration);
+}
+
+void AudioService::AdaptUplink(const AudioLinkStats& link_stats) {
+    if (!uplink_params_.adaptive) {
+        return;
+    }
+
+    // Counters only move forward within a session, a late packet may take back a loss
+    if (link_stats.received < last_link_stats_.received) {
+        last_link_stats_ = AudioLinkStats();
+    }
+    uint32_t received = link_stats.received - last_link_stats_.received;
+    uint32_t lost = link_stats.lost > last_link_stats_.lost ? link_stats.lost - last_link_stats_.lost : 0;
+    last_link_stats_ = link_stats;
+    uint32_t total = received + lost;
+
+    int frame_duration = uplink_frame_duration_ms_;
+    int backlog_ms = send_queue_peak_.exchange(0) * frame_duration;
+    bool lossy = total >= UPLINK_LOSS_MIN_PACKETS && lost * 100 >= total * UPLINK_LOSS_HIGH_PERCENT;
+    bool clean = lost * 100 < total * UPLINK_LOSS_LOW_PERCENT || lost == 0;
+
+    int new_frame_duration = frame_duration;
+    if (lossy || backlog_ms >= UPLINK_BACKLOG_HIGH_MS) {
+        // Fewer, longer packets: less header overhead and fewer chances to lose one
+        healthy_intervals_ = 0;
+        new_frame_duration = std::min(frame_duration + 20, 60);
+    } else if (clean && backlog_ms <= 2 * frame_duration) {
+        if (++healthy_intervals_ >= UPLINK_HEALTHY_INTERVALS) {
+            healthy_intervals_ = 0;
+            new_frame_duration = std::max(frame_duration - 20, uplink_params_.frame_duration);
+        }
+    } else {
+        healthy_intervals_ = 0;
+    }
+
+    if (new_frame_duration != frame_duration) {
+        ESP_LOGI(TAG, "Uplink adapt: lost %lu/%lu, backlog %d ms, frame duration %d -> %d ms",
+            lost, total, backlog_ms, frame_duration, new_frame_duration);
+        uplink_frame_duration_ms_ = new_frame_duration;
+        audio_processor_->SetFrameDuration(new_frame_duration);
+    }
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
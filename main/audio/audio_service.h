@@ -2,10 +2,9 @@
 #define AUDIO_SERVICE_H
 
 #include <memory>
-#include <deque>
-#include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -21,17 +20,28 @@
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
+#include "spsc_ring.h"
+#include "frame_pool.h"
+#include "packet_spill_buffer.h"
+#include "latency_histogram.h"
+#include "jitter_buffer.h"
 
 
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Jitter Buffer] -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
  *
- * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ * We use one task each for MIC, Speaker, Opus Encoder and Opus Decoder, so a slow decode of a
+ * server frame never delays the uplink encode and vice versa.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
- * 
+ *
+ * Every queue is a lock-free SpscRing. A task blocked on a queue sleeps on its task notification
+ * and is only woken by the peer of that queue, instead of all tasks sharing one condition variable.
+ * The decode queue has several producers (network, PlaySound, audio testing), so its producers
+ * are serialized by decode_producer_mutex_. The encode queue is fed by the audio processor output
+ * and by audio testing, serialized by encode_producer_mutex_. The consumer side never takes a lock.
  */
 
 #define OPUS_FRAME_DURATION_MS 60
@@ -42,6 +52,31 @@
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
 
+/* Ring capacities, must be powers of two and leave room for items discarded by Clear() */
+#define ENCODE_RING_CAPACITY 4
+#define PLAYBACK_RING_CAPACITY 4
+#define DECODE_RING_CAPACITY 256
+#define SEND_RING_CAPACITY 64
+#define TESTING_RING_CAPACITY 256
+#define TIMESTAMP_RING_CAPACITY 16
+
+/* Speech captured while the audio channel opens spills out of the send queue into a byte ring
+   sized for the 10 s hello timeout plus the connect, at about 2.5 KB/s of Opus and its headers */
+#define SEND_SPILL_SPIRAM_SIZE (48 * 1024)
+#define SEND_SPILL_INTERNAL_SIZE (16 * 1024)
+#define SEND_SPILL_MIN_ROOM 512
+
+/* Encode and playback queues, plus one frame in flight in each audio task */
+#define AUDIO_TASK_POOL_SIZE (MAX_ENCODE_TASKS_IN_QUEUE + MAX_PLAYBACK_TASKS_IN_QUEUE + 3)
+#define AUDIO_PACKET_POOL_SIZE 32
+
+// Uplink adaptation, evaluated by AdaptUplink about once a second
+#define UPLINK_LOSS_MIN_PACKETS 10
+#define UPLINK_LOSS_HIGH_PERCENT 5
+#define UPLINK_LOSS_LOW_PERCENT 1
+#define UPLINK_BACKLOG_HIGH_MS 360
+#define UPLINK_HEALTHY_INTERVALS 5
+
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
 
@@ -69,6 +104,24 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    int64_t origin_time_us;  // Uplink: PCM capture, downlink: network receive
+    int64_t stage_time_us;   // When the task entered its current queue
+};
+
+enum AudioLatencyStage {
+    /* Uplink */
+    kAudioLatencyCaptureToProcessed,    // Capture -> audio processor (AFE) output
+    kAudioLatencyEncodeQueueWait,       // Processor output -> encode start
+    kAudioLatencyEncode,
+    kAudioLatencySendQueueWait,         // Encoded -> sent by the main loop
+    kAudioLatencyCaptureToSend,         // Mouth to network
+    /* Downlink */
+    kAudioLatencyDecodeQueueWait,       // Network receive -> decode start
+    kAudioLatencyDecode,
+    kAudioLatencyPlaybackQueueWait,     // Decoded -> I2S write start
+    kAudioLatencyI2sWrite,
+    kAudioLatencyReceiveToPlayback,     // Network to ear
+    kAudioLatencyStageCount,
 };
 
 struct DebugStatistics {
@@ -103,9 +156,23 @@ public:
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    std::unique_ptr<AudioStreamPacket> AcquirePacket();
+    void ReleasePacket(std::unique_ptr<AudioStreamPacket> packet);
+    FramePoolStats GetTaskPoolStats() { return task_pool_.GetStats(); }
+    FramePoolStats GetPacketPoolStats() { return packet_pool_.GetStats(); }
+    const LatencyHistogram& GetLatencyHistogram(AudioLatencyStage stage) const { return latency_histograms_[stage]; }
+    void RecordPacketSent(const AudioStreamPacket& packet);
+    std::string GetLatencyJson();
+    void ResetLatencyHistograms();
+    JitterBufferStats GetJitterBufferStats();
     void PlaySound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
+    void SetUplinkAudioParams(const UplinkAudioParams& params);
+    void AdaptUplink(const AudioLinkStats& link_stats);
+    void SetAudioChannelOpening(bool opening);
+    int uplink_frame_duration() const { return uplink_frame_duration_ms_; }
+    void SetSendBatchDuration(int duration_ms) { send_batch_ms_ = duration_ms; }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -119,27 +186,66 @@ private:
     OpusResampler reference_resampler_;
     OpusResampler output_resampler_;
     DebugStatistics debug_statistics_;
+    std::array<LatencyHistogram, kAudioLatencyStageCount> latency_histograms_;
+    // Capture clock used to estimate when an audio processor output frame was captured
+    std::atomic<uint32_t> captured_samples_ = 0;
+    std::atomic<uint32_t> processed_samples_ = 0;
+    std::atomic<int64_t> last_capture_time_us_ = 0;
+    FramePool<AudioTask> task_pool_{AUDIO_TASK_POOL_SIZE};
+    FramePool<AudioStreamPacket> packet_pool_{AUDIO_PACKET_POOL_SIZE};
+
+    // Scratch buffers reused by every frame, owned by the task noted
+    std::vector<int16_t> input_buffer_;           // AudioInputTask
+    std::vector<int16_t> mic_channel_;            // ReadAudioData
+    std::vector<int16_t> reference_channel_;      // ReadAudioData
+    std::vector<int16_t> resampled_mic_;          // ReadAudioData
+    std::vector<int16_t> resampled_reference_;    // ReadAudioData
+    std::vector<int16_t> output_resample_buffer_; // OpusDecodeTask
+
+    // Reorders incoming packets and conceals lost ones, owned by OpusDecodeTask
+    JitterBuffer jitter_buffer_{[this](std::unique_ptr<AudioStreamPacket> packet) {
+        packet_pool_.Release(std::move(packet));
+    }};
+    std::atomic<bool> jitter_buffer_reset_ = false;
+    std::mutex jitter_stats_mutex_;
+    JitterBufferStats jitter_stats_;
+
+    // Uplink encoding, written by the main loop and picked up by OpusEncodeTask at the next frame
+    std::atomic<int> uplink_frame_duration_ms_ = OPUS_FRAME_DURATION_MS;
+    std::atomic<bool> uplink_dtx_ = false;
+    std::atomic<size_t> send_queue_peak_ = 0;
+    bool encoder_dtx_ = false;                    // OpusEncodeTask
+    // Packets are announced to the main loop in batches of this duration, 0 announces every packet
+    std::atomic<int> send_batch_ms_ = 0;
+    int pending_send_ms_ = 0;                     // OpusEncodeTask
+    UplinkAudioParams uplink_params_;             // main loop
+    AudioLinkStats last_link_stats_;              // main loop
+    int healthy_intervals_ = 0;                   // main loop
 
     EventGroupHandle_t event_group_;
 
     // Audio encode / decode
     TaskHandle_t audio_input_task_handle_ = nullptr;
     TaskHandle_t audio_output_task_handle_ = nullptr;
-    TaskHandle_t opus_codec_task_handle_ = nullptr;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    TaskHandle_t opus_encode_task_handle_ = nullptr;
+    TaskHandle_t opus_decode_task_handle_ = nullptr;
+    std::mutex decode_producer_mutex_;
+    std::mutex encode_producer_mutex_;
+    SpscRing<std::unique_ptr<AudioStreamPacket>, DECODE_RING_CAPACITY> audio_decode_queue_{packet_pool_.Releaser()};
+    SpscRing<std::unique_ptr<AudioStreamPacket>, SEND_RING_CAPACITY> audio_send_queue_{packet_pool_.Releaser()};
+    // Takes the packets beyond MAX_SEND_PACKETS_IN_QUEUE while the audio channel opens
+    PacketSpillBuffer send_spill_;
+    std::atomic<bool> audio_channel_opening_ = false;
+    SpscRing<std::unique_ptr<AudioStreamPacket>, TESTING_RING_CAPACITY> audio_testing_queue_{packet_pool_.Releaser()};
+    SpscRing<std::unique_ptr<AudioTask>, ENCODE_RING_CAPACITY> audio_encode_queue_{task_pool_.Releaser()};
+    SpscRing<std::unique_ptr<AudioTask>, PLAYBACK_RING_CAPACITY> audio_playback_queue_{task_pool_.Releaser()};
     // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    SpscRing<uint32_t, TIMESTAMP_RING_CAPACITY> timestamp_queue_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
-    bool service_stopped_ = true;
+    std::atomic<bool> service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
@@ -148,10 +254,15 @@ private:
 
     void AudioInputTask();
     void AudioOutputTask();
-    void OpusCodecTask();
-    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void OpusEncodeTask();
+    void OpusDecodeTask();
+    bool IsSendQueueFull() const;
+    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, int64_t capture_time_us);
+    int64_t EstimateCaptureTime(size_t samples);
+    std::unique_ptr<AudioTask> AcquireTask(AudioTaskType type);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
+    void NotifyAudioTasks();
 };
 
 #endif
\ No newline at end of file
@@ -5,14 +5,23 @@
 
 #include <driver/gpio.h>
 #include <driver/i2s_pdm.h>
+#include <vector>
 
 class NoAudioCodec : public AudioCodec {
 private:
+    // Conversion buffers reused by every frame, written by the output and input task respectively
+    std::vector<int32_t> write_buffer_;
+    std::vector<int32_t> read_buffer_;
+    int32_t volume_factor_ = 0;
+
+    void UpdateVolumeFactor();
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
 
 public:
     virtual ~NoAudioCodec();
+    virtual void Start() override;
+    virtual void SetOutputVolume(int volume) override;
 };
 
 class NoAudioCodecDuplex : public NoAudioCodec {
@@ -0,0 +1,103 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+struct FramePoolStats {
+    size_t capacity = 0;
+    size_t free = 0;
+    size_t high_water = 0;  // Peak number of pooled objects handed out at the same time
+    uint32_t misses = 0;    // Acquire() found the pool empty and allocated from the heap
+    uint32_t drops = 0;     // Release() found the pool full and freed the object
+};
+
+/*
+ * Fixed-capacity pool of recyclable audio objects (AudioTask, AudioStreamPacket).
+ *
+ * All objects are created and prepared (e.g. PCM buffers reserved) in Prewarm(), while the heap
+ * is still unfragmented, and handed back and forth afterwards without touching the allocator.
+ * Objects keep their vector capacity across Acquire()/Release(), so in steady state a frame
+ * costs no heap allocation. When the pool runs dry it falls back to the heap, and surplus
+ * objects are freed on release, so the pool never grows beyond its capacity.
+ */
+template <typename T>
+class FramePool {
+public:
+    explicit FramePool(size_t capacity) : capacity_(capacity) {
+        free_.reserve(capacity);
+    }
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    void Prewarm(std::function<void(T&)> prepare = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (free_.size() < capacity_) {
+            auto item = std::make_unique<T>();
+            if (prepare) {
+                prepare(*item);
+            }
+            free_.push_back(std::move(item));
+        }
+        min_free_ = free_.size();
+    }
+
+    std::unique_ptr<T> Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                auto item = std::move(free_.back());
+                free_.pop_back();
+                if (free_.size() < min_free_) {
+                    min_free_ = free_.size();
+                }
+                return item;
+            }
+            misses_++;
+            min_free_ = 0;
+        }
+        return std::make_unique<T>();
+    }
+
+    void Release(std::unique_ptr<T> item) {
+        if (!item) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < capacity_) {
+            free_.push_back(std::move(item));
+        } else {
+            drops_++;
+        }
+    }
+
+    /* For containers that drop items on their own, e.g. SpscRing::Clear() */
+    std::function<void(std::unique_ptr<T>&&)> Releaser() {
+        return [this](std::unique_ptr<T>&& item) { Release(std::move(item)); };
+    }
+
+    FramePoolStats GetStats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FramePoolStats stats;
+        stats.capacity = capacity_;
+        stats.free = free_.size();
+        stats.high_water = capacity_ - min_free_;
+        stats.misses = misses_;
+        stats.drops = drops_;
+        return stats;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<T>> free_;
+    size_t capacity_;
+    size_t min_free_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t drops_ = 0;
+};
+
+#endif // FRAME_POOL_H
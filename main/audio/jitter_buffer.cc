@@ -0,0 +1,182 @@
+#include "jitter_buffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#define MAX_JITTER_SAMPLE_US 1000000
+
+JitterBuffer::JitterBuffer(std::function<void(std::unique_ptr<AudioStreamPacket>)> release)
+    : release_(std::move(release)) {
+}
+
+void JitterBuffer::Reset() {
+    Flush();
+    started_ = false;
+    playing_ = false;
+    has_transit_ = false;
+    buffering_since_us_ = 0;
+    gap_since_us_ = 0;
+    consecutive_concealed_ = 0;
+    // The jitter estimate and target depth describe the network, keep them for the next stream
+}
+
+void JitterBuffer::Flush() {
+    for (auto& slot : slots_) {
+        if (slot) {
+            release_(std::move(slot));
+        }
+    }
+    depth_ = 0;
+    stats_.depth = 0;
+}
+
+void JitterBuffer::Push(std::unique_ptr<AudioStreamPacket> packet, int64_t now_us) {
+    if (packet->frame_duration > 0) {
+        frame_duration_us_ = packet->frame_duration * 1000;
+    }
+    if (packet->sequence == 0) {
+        packet->sequence = started_ ? highest_sequence_ + 1 : 1;
+    }
+
+    uint32_t sequence = packet->sequence;
+    if (!started_ || static_cast<int32_t>(sequence - next_sequence_) < -4 * JITTER_BUFFER_CAPACITY) {
+        // First packet of a stream, or the sender restarted its sequence numbers
+        if (started_) {
+            Reset();
+        }
+        started_ = true;
+        next_sequence_ = sequence;
+        highest_sequence_ = sequence;
+    }
+
+    int32_t offset = static_cast<int32_t>(sequence - next_sequence_);
+    if (offset < 0) {
+        stats_.late++;
+        release_(std::move(packet));
+        return;
+    }
+    if (offset >= 2 * JITTER_BUFFER_CAPACITY) {
+        // A long burst was lost, everything buffered is too old to be played
+        stats_.lost += offset;
+        Flush();
+        next_sequence_ = sequence;
+        gap_since_us_ = 0;
+    } else {
+        // Give up on the oldest frames until the packet fits in the window
+        while (static_cast<int32_t>(sequence - next_sequence_) >= JITTER_BUFFER_CAPACITY) {
+            auto& slot = Slot(next_sequence_);
+            if (slot) {
+                release_(std::move(slot));
+                depth_--;
+            }
+            stats_.lost++;
+            next_sequence_++;
+            gap_since_us_ = 0;
+        }
+    }
+
+    auto& slot = Slot(sequence);
+    if (slot) {
+        stats_.duplicated++;
+        release_(std::move(packet));
+        return;
+    }
+
+    if (static_cast<int32_t>(sequence - highest_sequence_) < 0) {
+        stats_.reordered++;
+    } else {
+        highest_sequence_ = sequence;
+    }
+    if (!playing_ && depth_ == 0) {
+        // A new talkspurt, the silence before it is not jitter
+        has_transit_ = false;
+        buffering_since_us_ = now_us;
+    }
+    UpdateJitter(sequence, now_us);
+
+    slot = std::move(packet);
+    depth_++;
+    stats_.received++;
+    stats_.depth = depth_;
+}
+
+void JitterBuffer::UpdateJitter(uint32_t sequence, int64_t now_us) {
+    int64_t transit_us = now_us - (int64_t)sequence * frame_duration_us_;
+    if (has_transit_) {
+        int64_t delta_us = std::min<int64_t>(std::abs(transit_us - last_transit_us_), MAX_JITTER_SAMPLE_US);
+        jitter_us_ = (int64_t)jitter_us_ + (delta_us - (int64_t)jitter_us_) / 16;
+    }
+    last_transit_us_ = transit_us;
+    has_transit_ = true;
+
+    // Enough depth to ride out twice the mean deviation
+    uint32_t depth = 1 + (2 * jitter_us_ + frame_duration_us_ - 1) / frame_duration_us_;
+    target_depth_ = std::clamp<uint32_t>(depth, JITTER_BUFFER_MIN_DEPTH, JITTER_BUFFER_MAX_DEPTH);
+    stats_.jitter_us = jitter_us_;
+    stats_.target_depth = target_depth_;
+}
+
+void JitterBuffer::SkipToNextBuffered() {
+    while (!Slot(next_sequence_)) {
+        next_sequence_++;
+        stats_.lost++;
+    }
+}
+
+void JitterBuffer::TakeNext(std::unique_ptr<AudioStreamPacket>& packet) {
+    packet = std::move(Slot(next_sequence_));
+    next_sequence_++;
+    depth_--;
+    stats_.depth = depth_;
+    gap_since_us_ = 0;
+    consecutive_concealed_ = 0;
+}
+
+JitterBufferResult JitterBuffer::Pop(int64_t now_us, std::unique_ptr<AudioStreamPacket>& packet, int64_t& wait_us) {
+    wait_us = 0;
+    if (depth_ == 0) {
+        // Underrun or end of stream, buffer up to the target depth again before playing
+        playing_ = false;
+        return kJitterBufferEmpty;
+    }
+
+    if (!playing_) {
+        int64_t waited_us = now_us - buffering_since_us_;
+        int64_t needed_us = (int64_t)target_depth_ * frame_duration_us_;
+        if (depth_ < target_depth_ && waited_us < needed_us) {
+            wait_us = needed_us - waited_us;
+            return kJitterBufferWait;
+        }
+        playing_ = true;
+        SkipToNextBuffered();
+    }
+
+    if (Slot(next_sequence_)) {
+        TakeNext(packet);
+        return kJitterBufferPacket;
+    }
+
+    // The next frame is missing, give it as long as the target depth to show up
+    if (gap_since_us_ == 0) {
+        gap_since_us_ = now_us;
+    }
+    int64_t waited_us = now_us - gap_since_us_;
+    int64_t patience_us = (int64_t)target_depth_ * frame_duration_us_;
+    if (depth_ < target_depth_ && waited_us < patience_us) {
+        wait_us = patience_us - waited_us;
+        return kJitterBufferWait;
+    }
+
+    if (consecutive_concealed_ < JITTER_BUFFER_MAX_CONCEALED_FRAMES) {
+        // Concealment sounds worse the longer it runs, so only bridge short gaps
+        next_sequence_++;
+        consecutive_concealed_++;
+        stats_.lost++;
+        stats_.concealed++;
+        return kJitterBufferLost;
+    }
+
+    SkipToNextBuffered();
+    TakeNext(packet);
+    return kJitterBufferPacket;
+}
@@ -0,0 +1,85 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <array>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "protocol.h"
+
+#define JITTER_BUFFER_CAPACITY 16
+#define JITTER_BUFFER_MIN_DEPTH 1
+#define JITTER_BUFFER_MAX_DEPTH 8
+#define JITTER_BUFFER_MAX_CONCEALED_FRAMES 3
+
+/*
+ * Adaptive jitter buffer for incoming server audio.
+ *
+ * Packets are slotted by sequence number, so out-of-order packets are played in order and
+ * late or duplicated ones are dropped. The target depth follows the RFC 3550 interarrival
+ * jitter: playout (re)starts once that many frames are buffered, and a missing frame is
+ * concealed once the frames behind it cover the target depth.
+ *
+ * Packets without a sequence number (0) are numbered in arrival order.
+ * Not thread safe, owned by the Opus decoder task.
+ */
+
+enum JitterBufferResult {
+    kJitterBufferEmpty,     // Nothing buffered, wait for the next packet
+    kJitterBufferWait,      // Buffering or waiting for a missing frame, retry after wait_us
+    kJitterBufferPacket,    // The next frame is ready
+    kJitterBufferLost,      // The next frame is lost, conceal it
+};
+
+struct JitterBufferStats {
+    uint32_t jitter_us = 0;
+    uint32_t target_depth = 0;
+    uint32_t depth = 0;
+    uint32_t received = 0;
+    uint32_t reordered = 0;
+    uint32_t late = 0;
+    uint32_t duplicated = 0;
+    uint32_t lost = 0;
+    uint32_t concealed = 0;
+};
+
+class JitterBuffer {
+public:
+    /* `release` takes back every packet the buffer drops (late, duplicated, flushed) */
+    explicit JitterBuffer(std::function<void(std::unique_ptr<AudioStreamPacket>)> release);
+
+    void Reset();
+    bool Full() const { return depth_ >= JITTER_BUFFER_CAPACITY; }
+
+    void Push(std::unique_ptr<AudioStreamPacket> packet, int64_t now_us);
+    JitterBufferResult Pop(int64_t now_us, std::unique_ptr<AudioStreamPacket>& packet, int64_t& wait_us);
+    const JitterBufferStats& stats() const { return stats_; }
+
+private:
+    std::function<void(std::unique_ptr<AudioStreamPacket>)> release_;
+    std::array<std::unique_ptr<AudioStreamPacket>, JITTER_BUFFER_CAPACITY> slots_;
+    JitterBufferStats stats_;
+    uint32_t depth_ = 0;
+    bool started_ = false;
+    bool playing_ = false;
+    uint32_t next_sequence_ = 0;
+    uint32_t highest_sequence_ = 0;
+    int frame_duration_us_ = 60000;
+    int64_t buffering_since_us_ = 0;
+    int64_t gap_since_us_ = 0;
+    int consecutive_concealed_ = 0;
+    // Interarrival jitter estimate, RFC 3550 section 6.4.1
+    int64_t last_transit_us_ = 0;
+    bool has_transit_ = false;
+    uint32_t jitter_us_ = 0;
+    uint32_t target_depth_ = JITTER_BUFFER_MIN_DEPTH;
+
+    std::unique_ptr<AudioStreamPacket>& Slot(uint32_t sequence) { return slots_[sequence % JITTER_BUFFER_CAPACITY]; }
+    void UpdateJitter(uint32_t sequence, int64_t now_us);
+    void Flush();
+    void SkipToNextBuffered();
+    void TakeNext(std::unique_ptr<AudioStreamPacket>& packet);
+};
+
+#endif // JITTER_BUFFER_H
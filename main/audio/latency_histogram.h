@@ -0,0 +1,84 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Fixed-bucket latency histogram.
+ *
+ * Record() is lock-free and meant to be called by a single audio task per histogram;
+ * the statistics can be read from any task. Percentiles are reported as the upper bound
+ * of the bucket that contains them, which is precise enough to tell 5 ms from 50 ms.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t kBucketCount = 12;
+    /* Upper bound of each bucket in milliseconds, the last bucket is unbounded */
+    static constexpr std::array<uint32_t, kBucketCount - 1> kBucketLimitsMs = {
+        1, 2, 5, 10, 20, 40, 60, 100, 200, 500, 1000
+    };
+
+    void Record(int64_t duration_us) {
+        if (duration_us < 0) {
+            duration_us = 0;
+        }
+        uint32_t duration_ms = duration_us / 1000;
+        size_t index = 0;
+        while (index < kBucketLimitsMs.size() && duration_ms >= kBucketLimitsMs[index]) {
+            index++;
+        }
+        buckets_[index].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        total_us_.fetch_add(duration_us, std::memory_order_relaxed);
+        uint32_t max_us = max_us_.load(std::memory_order_relaxed);
+        if (duration_us > max_us) {
+            max_us_.store(duration_us, std::memory_order_relaxed);
+        }
+    }
+
+    void Reset() {
+        for (auto& bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        total_us_.store(0, std::memory_order_relaxed);
+        max_us_.store(0, std::memory_order_relaxed);
+    }
+
+    uint32_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint32_t max_us() const { return max_us_.load(std::memory_order_relaxed); }
+    uint32_t bucket(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    uint32_t average_us() const {
+        uint32_t count = this->count();
+        return count == 0 ? 0 : total_us_.load(std::memory_order_relaxed) / count;
+    }
+
+    /* Returns the bucket upper bound (ms) below which `percent` of the samples fall, -1 if unbounded */
+    int PercentileMs(int percent) const {
+        uint32_t count = this->count();
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t target = ((uint64_t)count * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; i++) {
+            seen += bucket(i);
+            if (seen >= target) {
+                return i < kBucketLimitsMs.size() ? (int)kBucketLimitsMs[i] : -1;
+            }
+        }
+        return -1;
+    }
+
+private:
+    std::array<std::atomic<uint32_t>, kBucketCount> buckets_ = {};
+    std::atomic<uint32_t> count_ = 0;
+    std::atomic<uint64_t> total_us_ = 0;
+    std::atomic<uint32_t> max_us_ = 0;
+};
+
+#endif // LATENCY_HISTOGRAM_H
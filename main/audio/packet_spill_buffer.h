@@ -0,0 +1,154 @@
+#ifndef PACKET_SPILL_BUFFER_H
+#define PACKET_SPILL_BUFFER_H
+
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <esp_heap_caps.h>
+
+#include "protocol.h"
+
+/*
+ * Byte ring that takes encoded uplink packets while the send queue is full, e.g. the speech
+ * captured while the audio channel opens after a wake word.
+ *
+ * Each packet is stored as a 24-byte record header (payload size, frame duration, timestamp,
+ * latency tracing times) followed by its payload, so holding seconds of audio costs a few bytes
+ * per frame instead of a pooled AudioStreamPacket each. The buffer is allocated on demand,
+ * preferring PSRAM, and released again once it has been drained.
+ *
+ * Push() and Pop() may run on different tasks, they are serialized by a mutex. Empty() does not
+ * lock, so the steady state, where nothing spills, never takes the mutex.
+ */
+class PacketSpillBuffer {
+public:
+    PacketSpillBuffer() = default;
+    PacketSpillBuffer(const PacketSpillBuffer&) = delete;
+    PacketSpillBuffer& operator=(const PacketSpillBuffer&) = delete;
+
+    ~PacketSpillBuffer() {
+        heap_caps_free(buffer_);
+    }
+
+    /* Tries PSRAM first, then `internal_size` bytes of internal memory */
+    bool Allocate(size_t spiram_size, size_t internal_size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffer_ != nullptr) {
+            return true;
+        }
+        size_t size = spiram_size;
+        buffer_ = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (buffer_ == nullptr && internal_size > 0) {
+            size = internal_size;
+            buffer_ = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (buffer_ == nullptr) {
+            return false;
+        }
+        capacity_ = size;
+        head_ = 0;
+        used_ = 0;
+        return true;
+    }
+
+    /* Frees the buffer if nothing is left in it */
+    void ReleaseIfEmpty() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffer_ != nullptr && count_ == 0) {
+            heap_caps_free(buffer_);
+            buffer_ = nullptr;
+            capacity_ = 0;
+        }
+    }
+
+    bool HasRoom(size_t payload_size) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return buffer_ != nullptr && capacity_ - used_ >= sizeof(Record) + payload_size;
+    }
+
+    bool Push(const AudioStreamPacket& packet) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t size = packet.payload.size();
+        if (buffer_ == nullptr || size > UINT16_MAX || capacity_ - used_ < sizeof(Record) + size) {
+            return false;
+        }
+        Record record = {
+            .payload_size = (uint16_t)size,
+            .frame_duration = (uint16_t)packet.frame_duration,
+            .timestamp = packet.timestamp,
+            .origin_time_us = packet.origin_time_us,
+            .stage_time_us = packet.stage_time_us,
+        };
+        Write(&record, sizeof(record));
+        Write(packet.payload.data(), size);
+        count_++;
+        return true;
+    }
+
+    /* Fills `packet` with the oldest record, its payload keeps its capacity */
+    bool Pop(AudioStreamPacket& packet) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == 0) {
+            return false;
+        }
+        Record record;
+        Read(&record, sizeof(record));
+        packet.sample_rate = 16000;
+        packet.frame_duration = record.frame_duration;
+        packet.timestamp = record.timestamp;
+        packet.origin_time_us = record.origin_time_us;
+        packet.stage_time_us = record.stage_time_us;
+        packet.payload.resize(record.payload_size);
+        Read(packet.payload.data(), record.payload_size);
+        count_--;
+        return true;
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        head_ = 0;
+        used_ = 0;
+        count_ = 0;
+    }
+
+    size_t Count() const { return count_.load(std::memory_order_acquire); }
+    bool Empty() const { return Count() == 0; }
+
+private:
+    struct Record {
+        uint16_t payload_size;
+        uint16_t frame_duration;
+        uint32_t timestamp;
+        int64_t origin_time_us;
+        int64_t stage_time_us;
+    };
+
+    mutable std::mutex mutex_;
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t head_ = 0;
+    size_t used_ = 0;
+    std::atomic<size_t> count_ = 0;
+
+    void Write(const void* data, size_t size) {
+        size_t tail = (head_ + used_) % capacity_;
+        size_t first = std::min(size, capacity_ - tail);
+        memcpy(buffer_ + tail, data, first);
+        memcpy(buffer_, (const uint8_t*)data + first, size - first);
+        used_ += size;
+    }
+
+    void Read(void* data, size_t size) {
+        size_t first = std::min(size, capacity_ - head_);
+        memcpy(data, buffer_ + head_, first);
+        memcpy((uint8_t*)data + first, buffer_, size - first);
+        head_ = (head_ + size) % capacity_;
+        used_ -= size;
+    }
+};
+
+#endif // PACKET_SPILL_BUFFER_H
@@ -0,0 +1,64 @@
+#ifndef PCM_FRAMER_H
+#define PCM_FRAMER_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Re-frames a stream of PCM chunks of any size into fixed-size frames.
+ *
+ * Every sample is copied exactly once, straight into the frame being built, and a full frame
+ * is handed to the callback as a vector it may move or swap from. Nothing is ever shifted to
+ * the front of a buffer. If the callback swaps a recycled buffer back in (as AudioService does
+ * with its pooled tasks), building the next frame allocates nothing.
+ * Samples pushed before a frame size is set are dropped.
+ */
+class PcmFramer {
+public:
+    /* Pending samples are kept, a frame that is already longer than the new size goes out as is */
+    void SetFrameSamples(size_t frame_samples) {
+        frame_samples_ = frame_samples;
+        frame_.reserve(frame_samples_);
+    }
+
+    void Reset() {
+        frame_.clear();
+    }
+
+    size_t frame_samples() const { return frame_samples_; }
+    size_t pending_samples() const { return frame_.size(); }
+
+    template <typename Callback>
+    void Push(const int16_t* data, size_t samples, Callback&& on_frame) {
+        if (frame_samples_ == 0) {
+            return;
+        }
+        while (samples > 0) {
+            if (frame_.size() >= frame_samples_) {
+                on_frame(frame_);
+                frame_.clear();
+                frame_.reserve(frame_samples_);
+            }
+            size_t count = frame_samples_ - frame_.size();
+            if (count > samples) {
+                count = samples;
+            }
+            frame_.insert(frame_.end(), data, data + count);
+            data += count;
+            samples -= count;
+
+            if (frame_.size() == frame_samples_) {
+                on_frame(frame_);
+                frame_.clear();
+                frame_.reserve(frame_samples_);
+            }
+        }
+    }
+
+private:
+    size_t frame_samples_ = 0;
+    std::vector<int16_t> frame_;
+};
+
+#endif // PCM_FRAMER_H
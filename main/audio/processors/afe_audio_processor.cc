@@ -15,7 +15,7 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 
     // Pre-allocate output buffer capacity
-    output_buffer_.reserve(frame_samples_);
+    output_framer_.SetFrameSamples(frame_samples_);
 
     int ref_num = codec_->input_reference() ? 1 : 0;
 
@@ -100,6 +100,8 @@ void AfeAudioProcessor::Stop() {
     if (afe_data_ != nullptr) {
         afe_iface_->reset_buffer(afe_data_);
     }
+    // Drop the partial frame too, the processor task owns the framer
+    framer_reset_ = true;
 }
 
 bool AfeAudioProcessor::IsRunning() {
@@ -145,29 +147,25 @@ void AfeAudioProcessor::AudioProcessorTask() {
             }
         }
 
+        if (framer_reset_.exchange(false)) {
+            output_framer_.Reset();
+        }
         if (output_callback_) {
-            size_t samples = res->data_size / sizeof(int16_t);
-            
-            // Add data to buffer
-            output_buffer_.insert(output_buffer_.end(), res->data, res->data + samples);
-            
-            // Output complete frames when buffer has enough data
-            while (output_buffer_.size() >= frame_samples_) {
-                if (output_buffer_.size() == frame_samples_) {
-                    // If buffer size equals frame size, move the entire buffer
-                    output_callback_(std::move(output_buffer_));
-                    output_buffer_.clear();
-                    output_buffer_.reserve(frame_samples_);
-                } else {
-                    // If buffer size exceeds frame size, copy one frame and remove it
-                    output_callback_(std::vector<int16_t>(output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-                    output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
-                }
+            if (output_framer_.frame_samples() != (size_t)frame_samples_) {
+                output_framer_.SetFrameSamples(frame_samples_);
             }
+            output_framer_.Push(res->data, res->data_size / sizeof(int16_t), [this](std::vector<int16_t>& frame) {
+                output_callback_(std::move(frame));
+            });
         }
     }
 }
 
+void AfeAudioProcessor::SetFrameDuration(int frame_duration_ms) {
+    // Applied by the processor task before it frames the next fetch
+    frame_samples_ = frame_duration_ms * 16000 / 1000;
+}
+
 void AfeAudioProcessor::EnableDeviceAec(bool enable) {
     if (enable) {
 #if CONFIG_USE_DEVICE_AEC
@@ -9,9 +9,11 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <atomic>
 
 #include "audio_processor.h"
 #include "audio_codec.h"
+#include "pcm_framer.h"
 
 class AfeAudioProcessor : public AudioProcessor {
 public:
@@ -27,6 +29,7 @@ public:
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
+    void SetFrameDuration(int frame_duration_ms) override;
 
 private:
     EventGroupHandle_t event_group_ = nullptr;
@@ -35,9 +38,10 @@ private:
     std::function<void(std::vector<int16_t>&& data)> output_callback_;
     std::function<void(bool speaking)> vad_state_change_callback_;
     AudioCodec* codec_ = nullptr;
-    int frame_samples_ = 0;
+    std::atomic<int> frame_samples_ = 0;
     bool is_speaking_ = false;
-    std::vector<int16_t> output_buffer_;
+    PcmFramer output_framer_;
+    std::atomic<bool> framer_reset_ = false;  // Set by Stop(), applied by the processor task
 
     void AudioProcessorTask();
 };
@@ -1,4 +1,5 @@
 #include "no_audio_processor.h"
+#include "audio_channels.h"
 #include <esp_log.h>
 
 #define TAG "NoAudioProcessor"
@@ -13,21 +14,17 @@ void NoAudioProcessor::Feed(std::vector<int16_t>&& data) {
         return;
     }
 
-    if (data.size() != frame_samples_) {
-        ESP_LOGE(TAG, "Feed data size is not equal to frame size, feed size: %u, frame size: %u", data.size(), frame_samples_);
+    if (data.size() != (size_t)frame_samples_) {
+        ESP_LOGE(TAG, "Feed data size is not equal to frame size, feed size: %u, frame size: %d", data.size(), frame_samples_.load());
         return;
     }
 
     if (codec_->input_channels() == 2) {
-        // If input channels is 2, we need to fetch the left channel data
-        auto mono_data = std::vector<int16_t>(data.size() / 2);
-        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-            mono_data[i] = data[j];
-        }
-        output_callback_(std::move(mono_data));
-    } else {
-        output_callback_(std::move(data));
+        // If input channels is 2, we need to fetch the left channel data (in place, no allocation)
+        ExtractChannel(data.data(), data.data(), data.size() / 2, 2, 0);
+        data.resize(data.size() / 2);
     }
+    output_callback_(std::move(data));
 }
 
 void NoAudioProcessor::Start() {
@@ -57,6 +54,10 @@ size_t NoAudioProcessor::GetFeedSize() {
     return frame_samples_;
 }
 
+void NoAudioProcessor::SetFrameDuration(int frame_duration_ms) {
+    frame_samples_ = frame_duration_ms * 16000 / 1000;
+}
+
 void NoAudioProcessor::EnableDeviceAec(bool enable) {
     if (enable) {
         ESP_LOGE(TAG, "Device AEC is not supported");
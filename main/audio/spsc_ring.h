@@ -0,0 +1,109 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/*
+ * Lock-free single-producer / single-consumer ring buffer.
+ *
+ * Push() must only be called from one task at a time, and Pop() from one task at a time.
+ * Each side may register the task that waits on it: the consumer task is notified
+ * (xTaskNotifyGive) after every push, and the producer task after every pop, so only the
+ * peer that is actually waiting gets woken up.
+ *
+ * Clear() may be called from any task. It marks everything pushed so far as discarded,
+ * and the consumer releases those items on its next Pop(), handing each one to the
+ * releaser given at construction (e.g. back to its FramePool) instead of destroying it.
+ */
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    explicit SpscRing(std::function<void(T&&)> releaser = nullptr) : releaser_(std::move(releaser)) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    static constexpr size_t capacity() { return N; }
+
+    bool Push(T&& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        slots_[tail & (N - 1)] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        Notify(consumer_task_);
+        return true;
+    }
+
+    bool Pop(T& item) {
+        uint32_t discard = discard_until_.load(std::memory_order_acquire);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        while (head != tail && static_cast<int32_t>(discard - head) > 0) {
+            T& slot = slots_[head & (N - 1)];
+            if (releaser_) {
+                releaser_(std::move(slot));
+            }
+            slot = T();
+            head++;
+        }
+        if (head == tail) {
+            head_.store(head, std::memory_order_release);
+            return false;
+        }
+        item = std::move(slots_[head & (N - 1)]);
+        slots_[head & (N - 1)] = T();
+        head_.store(head + 1, std::memory_order_release);
+        Notify(producer_task_);
+        return true;
+    }
+
+    void Clear() {
+        discard_until_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+        Notify(producer_task_);
+        Notify(consumer_task_);
+    }
+
+    size_t Size() const {
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        uint32_t discard = discard_until_.load(std::memory_order_acquire);
+        if (static_cast<int32_t>(discard - head) > 0) {
+            head = discard;
+        }
+        return static_cast<int32_t>(tail - head) > 0 ? tail - head : 0;
+    }
+
+    bool Empty() const { return Size() == 0; }
+
+    void SetProducerTask(TaskHandle_t task) { producer_task_.store(task, std::memory_order_release); }
+    void SetConsumerTask(TaskHandle_t task) { consumer_task_.store(task, std::memory_order_release); }
+
+private:
+    std::array<T, N> slots_;
+    std::function<void(T&&)> releaser_;
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> discard_until_{0};
+    std::atomic<TaskHandle_t> producer_task_{nullptr};
+    std::atomic<TaskHandle_t> consumer_task_{nullptr};
+
+    static void Notify(const std::atomic<TaskHandle_t>& task) {
+        TaskHandle_t handle = task.load(std::memory_order_acquire);
+        if (handle != nullptr) {
+            xTaskNotifyGive(handle);
+        }
+    }
+};
+
+#endif // SPSC_RING_H
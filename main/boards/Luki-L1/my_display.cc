@@ -283,16 +283,12 @@ void CustomEmojiDisplay::SetupGifContainer() {
     lv_obj_set_style_border_width(emotion_label_, 0, 0);
     lv_obj_add_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
 
-    emotion_gif_ = lv_gif_create(content_);
-    // int gif_size = LV_HOR_RES;
-    // lv_obj_set_size(emotion_gif_, gif_size, gif_size);
-    // lv_obj_set_style_border_width(emotion_gif_, 0, 0);
-    // lv_obj_set_style_bg_opa(emotion_gif_, LV_OPA_TRANSP, 0);
-    lv_obj_center(emotion_gif_);
-    lv_gif_set_src(emotion_gif_, &neutral);
+    emotion_gif_ = std::make_unique<GifPlayer>(content_);
+    lv_obj_center(emotion_gif_->obj());
+    emotion_gif_->SetSource(&neutral);
 
     //新添加循环
-    lv_gif_set_loop_count(emotion_gif_,0xffffffff);
+    emotion_gif_->SetLoopCount(0);
 
     chat_message_label_ = lv_label_create(content_);
     lv_label_set_text(chat_message_label_, "");
@@ -322,7 +318,7 @@ void CustomEmojiDisplay::SetEmotionSync(const char* emotion) {
 
     for (const auto& map : emotion_maps_) {
         if (map.name && strcmp(map.name, emotion) == 0) {
-            lv_gif_set_src(emotion_gif_, map.gif);
+            emotion_gif_->SetSource(map.gif);
             ESP_LOGI(TAG, "设置表情: %s", emotion);
             
             // // 根据设备状态和表情来决定是否显示状态栏
@@ -347,7 +343,7 @@ void CustomEmojiDisplay::SetEmotionSync(const char* emotion) {
     }
 
     // 默认使用neutral表情
-    lv_gif_set_src(emotion_gif_, &neutral);
+    emotion_gif_->SetSource(&neutral);
     ESP_LOGI(TAG, "未知表情'%s'，使用默认", emotion);
     
     // // 默认情况下根据设备状态决定状态栏显示
@@ -1,11 +1,12 @@
 #pragma once
 
-#include <libs/gif/lv_gif.h>
 #include <freertos/FreeRTOS.h>
+#include <memory>
 #include <freertos/task.h>
 #include <freertos/queue.h>
 
 #include "display/lcd_display.h"
+#include "display/gif_player.h"
 #include "application.h"  // 添加这个头文件以获取设备状态
  
 
@@ -78,7 +79,7 @@ private:
     // 停止显示刷新线程
     void StopDisplayRefreshThread();
 
-    lv_obj_t* emotion_gif_;  ///< GIF表情组件
+    std::unique_ptr<GifPlayer> emotion_gif_;  ///< GIF表情组件
     
     // 显示刷新线程相关成员
     TaskHandle_t display_task_handle_;
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include "esp_log.h"
 #include "display.h"
+#include "audio_channels.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -42,9 +43,7 @@ namespace audio_wifi_config
 
             if (input_channels == 2) { // 如果是双声道输入，转换为单声道
                 auto mono_data = std::vector<int16_t>(audio_data.size() / 2);
-                for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                    mono_data[i] = audio_data[j];
-                }
+                ExtractChannel(audio_data.data(), mono_data.data(), mono_data.size(), 2, 0);
                 audio_data = std::move(mono_data);
             }
             
@@ -10,6 +10,7 @@
 #include <freertos/queue.h>
 
 #include "camera.h"
+#include "preview_image.h"
 
 struct JpegChunk {
     uint8_t* data;
@@ -19,7 +20,11 @@ struct JpegChunk {
 class Esp32Camera : public Camera {
 private:
     camera_fb_t* fb_ = nullptr;
-    lv_img_dsc_t preview_image_;
+    uint32_t preview_width_ = 0;
+    uint32_t preview_height_ = 0;
+    // Shared with the display, written in turn so the one on screen is left alone
+    std::shared_ptr<PreviewImage> preview_images_[2];
+    int preview_index_ = 0;
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
@@ -40,7 +40,7 @@ void Ml307Board::StartNetwork() {
             if (device_state == kDeviceStateListening || device_state == kDeviceStateSpeaking) {
                 application.Schedule([this, &application]() {
                     application.SetDeviceState(kDeviceStateIdle);
-                });
+                }, kMainTaskControl, 0, kMainTaskAfterQueued);
             }
         }
     });
@@ -64,6 +64,8 @@ void PowerSaveTimer::PowerSaveCheck() {
         if (!in_sleep_mode_) {
             ESP_LOGI(TAG, "Enabling power save mode");
             in_sleep_mode_ = true;
+            // A warm standby connection would keep the radio busy
+            app.KeepAudioChannelWarm(false);
             if (on_enter_sleep_mode_) {
                 on_enter_sleep_mode_();
             }
@@ -121,5 +123,6 @@ void PowerSaveTimer::WakeUp() {
         if (on_exit_sleep_mode_) {
             on_exit_sleep_mode_();
         }
+        Application::GetInstance().KeepAudioChannelWarm(true);
     }
 }
@@ -8,6 +8,9 @@
 
 #include <string>
 #include <chrono>
+#include <memory>
+
+#include "preview_image.h"
 
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
@@ -15,6 +18,15 @@ struct DisplayFonts {
     const lv_font_t* emoji_font = nullptr;
 };
 
+struct DisplayRefreshStats {
+    uint32_t frames;        // Frames drawn in the window
+    uint32_t fps;
+    uint32_t pauses;        // Times the refresh timer was paused on a static screen
+    uint32_t render_avg_us; // Render and flush time of a frame
+    uint32_t render_max_us;
+    int render_p95_ms;
+};
+
 class Display {
 public:
     Display();
@@ -27,10 +39,14 @@ public:
     virtual void SetChatMessage(const char* role, const char* content);
     virtual void SetIcon(const char* icon);
     virtual void SetPreviewImage(const lv_img_dsc_t* image);
+    /* Shows `image` without copying it, the display keeps a reference while it is on screen */
+    virtual void SetSharedPreviewImage(std::shared_ptr<PreviewImage> image);
     virtual void SetTheme(const std::string& theme_name);
     virtual std::string GetTheme() { return current_theme_name_; }
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
+    /* Refresh statistics since the previous call, false if the display does not track them */
+    virtual bool GetRefreshStats(DisplayRefreshStats& stats) { return false; }
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
@@ -56,6 +72,7 @@ protected:
     const char* network_icon_ = nullptr;
     bool muted_ = false;
     std::string current_theme_name_;
+    std::shared_ptr<PreviewImage> shared_preview_image_;
 
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
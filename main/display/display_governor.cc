@@ -0,0 +1,116 @@
+#include "display_governor.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+
+#define TAG "DisplayGovernor"
+
+static uint32_t GetTickMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+DisplayBufferConfig DisplayGovernor::ChooseBuffers(int width, int height, int lines, bool allow_spiram) {
+    const uint32_t internal_caps = MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL;
+    size_t free_internal = heap_caps_get_free_size(internal_caps);
+    size_t largest_internal = heap_caps_get_largest_free_block(internal_caps);
+    // What is still free once the later allocations have been made
+    size_t internal_budget = free_internal > DISPLAY_LATER_INTERNAL_USAGE ? free_internal - DISPLAY_LATER_INTERNAL_USAGE : 0;
+#if CONFIG_SPIRAM
+    bool internal_double_buffer = true;
+#else
+    bool internal_double_buffer = false;
+#endif
+    size_t largest_spiram = allow_spiram ? heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) : 0;
+
+    DisplayBufferConfig config = {};
+    lines = std::max(std::min(lines, height), DISPLAY_MIN_BUFFER_LINES);
+    for (int n = lines; ; n = std::max(n / 2, DISPLAY_MIN_BUFFER_LINES)) {
+        size_t size = (size_t)width * n * sizeof(uint16_t);
+        config.buffer_size = width * n;
+        // Two buffers let LVGL render the next stripe while the previous one is being sent
+        if (internal_double_buffer && size <= largest_internal && size * 2 <= internal_budget) {
+            config.double_buffer = true;
+            break;
+        }
+        if (size * 2 <= largest_spiram) {
+            config.double_buffer = true;
+            config.spiram = true;
+            break;
+        }
+        // The single buffer of the requested size is what the display always had
+        if (size <= largest_internal && (n == lines || size <= internal_budget)) {
+            break;
+        }
+        if (n == DISPLAY_MIN_BUFFER_LINES) {
+            ESP_LOGW(TAG, "Low internal memory (%u free), using the smallest draw buffer", free_internal);
+            break;
+        }
+    }
+
+    ESP_LOGI(TAG, "Draw buffer: %lu lines%s in %s", config.buffer_size / width,
+        config.double_buffer ? " x2" : "", config.spiram ? "PSRAM" : "internal RAM");
+    return config;
+}
+
+void DisplayGovernor::Attach(lv_display_t* display) {
+    display_ = display;
+    lv_tick_set_cb(GetTickMs);
+    refr_timer_ = lv_display_get_refr_timer(display);
+    if (refr_timer_ != nullptr) {
+        lv_timer_set_period(refr_timer_, DISPLAY_ACTIVE_REFR_PERIOD_MS);
+    }
+    window_start_us_ = esp_timer_get_time();
+    lv_display_add_event_cb(display, OnEvent, LV_EVENT_ALL, this);
+}
+
+void DisplayGovernor::OnEvent(lv_event_t* e) {
+    auto self = static_cast<DisplayGovernor*>(lv_event_get_user_data(e));
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_INVALIDATE_AREA:
+        self->idle_refreshes_ = 0;
+        if (self->paused_) {
+            self->paused_ = false;
+            lv_timer_resume(self->refr_timer_);
+        }
+        break;
+    case LV_EVENT_RENDER_START:
+        self->render_start_us_ = esp_timer_get_time();
+        break;
+    case LV_EVENT_RENDER_READY:
+        self->render_histogram_.Record(esp_timer_get_time() - self->render_start_us_);
+        self->frames_.fetch_add(1, std::memory_order_relaxed);
+        self->rendered_ = true;
+        break;
+    case LV_EVENT_REFR_READY:
+        if (self->rendered_ || lv_anim_count_running() > 0) {
+            self->idle_refreshes_ = 0;
+        } else if (++self->idle_refreshes_ >= DISPLAY_IDLE_REFRESH_COUNT && self->refr_timer_ != nullptr && !self->paused_) {
+            // Static screen, nothing to refresh until an area is invalidated again
+            self->paused_ = true;
+            self->pauses_.fetch_add(1, std::memory_order_relaxed);
+            lv_timer_pause(self->refr_timer_);
+        }
+        self->rendered_ = false;
+        break;
+    default:
+        break;
+    }
+}
+
+DisplayRefreshStats DisplayGovernor::GetStats() {
+    DisplayRefreshStats stats = {};
+    int64_t now = esp_timer_get_time();
+    int64_t window_us = now - window_start_us_;
+    window_start_us_ = now;
+    stats.frames = frames_.exchange(0, std::memory_order_relaxed);
+    stats.pauses = pauses_.exchange(0, std::memory_order_relaxed);
+    stats.fps = window_us > 0 ? (uint64_t)stats.frames * 1000000 / window_us : 0;
+    stats.render_avg_us = render_histogram_.average_us();
+    stats.render_max_us = render_histogram_.max_us();
+    stats.render_p95_ms = render_histogram_.PercentileMs(95);
+    render_histogram_.Reset();
+    return stats;
+}
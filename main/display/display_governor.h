@@ -0,0 +1,66 @@
+#ifndef DISPLAY_GOVERNOR_H
+#define DISPLAY_GOVERNOR_H
+
+#include <lvgl.h>
+#include <esp_lvgl_port.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "display.h"
+#include "latency_histogram.h"
+
+// Refresh period while something is animating, scrolling or being redrawn
+#define DISPLAY_ACTIVE_REFR_PERIOD_MS 30
+// Refreshes in a row with nothing to draw before the refresh timer is paused
+#define DISPLAY_IDLE_REFRESH_COUNT 10
+// Longest sleep of the LVGL task, bounds the delay of an update made by another task while idle
+#define DISPLAY_TASK_MAX_SLEEP_MS 100
+// Internal memory that WiFi, the audio tasks and the AFE allocate after the display is created
+#define DISPLAY_LATER_INTERNAL_USAGE (96 * 1024)
+#define DISPLAY_MIN_BUFFER_LINES 10
+
+struct DisplayBufferConfig {
+    uint32_t buffer_size;   // In pixels
+    bool double_buffer;
+    bool spiram;
+};
+
+/*
+ * Sizes the LVGL draw buffers from the free heap and adapts the refresh rate of a display.
+ *
+ * The refresh timer runs at DISPLAY_ACTIVE_REFR_PERIOD_MS while anything is drawn or animated
+ * and is paused once the screen is static; the next invalidated area resumes it. The LVGL tick
+ * is read from esp_timer so that a slow port tick timer does not make animations step.
+ */
+class DisplayGovernor {
+public:
+    /*
+     * Prefers `lines` lines double buffered in internal DMA memory, then PSRAM if allowed, then
+     * fewer lines. Without PSRAM (C3, C6) the internal heap is shared with everything else and
+     * only a single buffer is used.
+     */
+    static DisplayBufferConfig ChooseBuffers(int width, int height, int lines, bool allow_spiram);
+
+    /* Call with the LVGL port lock held, once the display has been added */
+    void Attach(lv_display_t* display);
+    bool attached() const { return display_ != nullptr; }
+    /* Statistics since the previous call */
+    DisplayRefreshStats GetStats();
+
+private:
+    lv_display_t* display_ = nullptr;
+    lv_timer_t* refr_timer_ = nullptr;
+    int64_t render_start_us_ = 0;
+    int64_t window_start_us_ = 0;
+    bool rendered_ = false;
+    bool paused_ = false;
+    int idle_refreshes_ = 0;
+    std::atomic<uint32_t> frames_ = 0;
+    std::atomic<uint32_t> pauses_ = 0;
+    LatencyHistogram render_histogram_;
+
+    static void OnEvent(lv_event_t* e);
+};
+
+#endif // DISPLAY_GOVERNOR_H
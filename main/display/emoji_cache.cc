@@ -0,0 +1,119 @@
+#include "emoji_cache.h"
+#include "emotions.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#define TAG "EmojiCache"
+
+EmojiCache::~EmojiCache() {
+    for (auto& entry : entries_) {
+        if (entry.data != nullptr) {
+            lv_image_cache_drop(&entry.buf);
+            heap_caps_free(entry.data);
+        }
+    }
+}
+
+void EmojiCache::Init(lv_obj_t* parent, const lv_font_t* font) {
+    font_ = font;
+    if (font_ == nullptr) {
+        return;
+    }
+    size_ = lv_font_get_line_height(font_);
+    canvas_ = lv_canvas_create(parent);
+    lv_obj_add_flag(canvas_, LV_OBJ_FLAG_HIDDEN);
+}
+
+const lv_image_dsc_t* EmojiCache::Get(int emotion) {
+    if (canvas_ == nullptr || emotion < 0 || emotion >= EMOTION_COUNT) {
+        return nullptr;
+    }
+
+    Entry* victim = &entries_[0];
+    for (auto& entry : entries_) {
+        if (entry.emotion == emotion) {
+            entry.last_used = ++clock_;
+            return (const lv_image_dsc_t*)&entry.buf;
+        }
+        if (entry.last_used < victim->last_used) {
+            victim = &entry;
+        }
+    }
+
+    if (!Render(*victim, emotion)) {
+        return nullptr;
+    }
+    victim->last_used = ++clock_;
+    return (const lv_image_dsc_t*)&victim->buf;
+}
+
+bool EmojiCache::Render(Entry& entry, int emotion) {
+    // The software renderer cannot draw into RGB565A8, so the glyph is drawn in ARGB8888 first
+    uint32_t scratch_stride = lv_draw_buf_width_to_stride(size_, LV_COLOR_FORMAT_ARGB8888);
+    uint32_t scratch_size = scratch_stride * size_;
+    void* scratch = heap_caps_malloc(scratch_size, MALLOC_CAP_SPIRAM);
+    if (scratch == nullptr) {
+        scratch = heap_caps_malloc(scratch_size, MALLOC_CAP_8BIT);
+    }
+    if (scratch == nullptr) {
+        ESP_LOGW(TAG, "No memory to render a %ldpx emoji", size_);
+        return false;
+    }
+
+    // RGB565 plane followed by an A8 plane of half the stride
+    uint32_t stride = lv_draw_buf_width_to_stride(size_, LV_COLOR_FORMAT_RGB565A8);
+    uint32_t data_size = stride * size_ + stride / 2 * size_;
+    if (entry.data == nullptr) {
+        entry.data = heap_caps_malloc(data_size, MALLOC_CAP_SPIRAM);
+        if (entry.data == nullptr) {
+            entry.data = heap_caps_malloc(data_size, MALLOC_CAP_8BIT);
+        }
+        if (entry.data == nullptr) {
+            ESP_LOGW(TAG, "No memory for a %ldpx emoji", size_);
+            heap_caps_free(scratch);
+            return false;
+        }
+    } else {
+        // Same buffer, new pixels
+        lv_image_cache_drop(&entry.buf);
+    }
+    entry.emotion = -1;
+    if (lv_draw_buf_init(&scratch_, size_, size_, LV_COLOR_FORMAT_ARGB8888, scratch_stride, scratch, scratch_size) != LV_RESULT_OK ||
+        lv_draw_buf_init(&entry.buf, size_, size_, LV_COLOR_FORMAT_RGB565A8, stride, entry.data, data_size) != LV_RESULT_OK) {
+        heap_caps_free(scratch);
+        return false;
+    }
+
+    lv_canvas_set_draw_buf(canvas_, &scratch_);
+    lv_canvas_fill_bg(canvas_, lv_color_black(), LV_OPA_TRANSP);
+
+    lv_layer_t layer;
+    lv_canvas_init_layer(canvas_, &layer);
+    lv_draw_label_dsc_t label_dsc;
+    lv_draw_label_dsc_init(&label_dsc);
+    label_dsc.font = font_;
+    label_dsc.text = kEmotions[emotion].emoji;
+    label_dsc.align = LV_TEXT_ALIGN_CENTER;
+    lv_area_t area = {0, 0, size_ - 1, size_ - 1};
+    lv_draw_label(&layer, &label_dsc, &area);
+    lv_canvas_finish_layer(canvas_, &layer);
+
+    auto rgb = (uint8_t*)entry.data;
+    auto alpha = rgb + stride * size_;
+    for (int32_t y = 0; y < size_; y++) {
+        auto src = (const lv_color32_t*)((const uint8_t*)scratch + y * scratch_stride);
+        auto dst = (uint16_t*)(rgb + y * stride);
+        auto dst_alpha = alpha + y * (stride / 2);
+        for (int32_t x = 0; x < size_; x++) {
+            dst[x] = ((src[x].red & 0xF8) << 8) | ((src[x].green & 0xFC) << 3) | (src[x].blue >> 3);
+            dst_alpha[x] = src[x].alpha;
+        }
+    }
+    // The hidden canvas keeps pointing at scratch_, only its pixel data goes away
+    heap_caps_free(scratch);
+    scratch_.data = nullptr;
+
+    entry.emotion = emotion;
+    return true;
+}
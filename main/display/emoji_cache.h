@@ -0,0 +1,55 @@
+#ifndef EMOJI_CACHE_H
+#define EMOJI_CACHE_H
+
+#include "emotions.h"
+
+#include <lvgl.h>
+
+#include <cstdint>
+
+// Pre-rendered emoji kept in memory, each one takes line height squared times 3 bytes
+#if CONFIG_SPIRAM
+#define EMOJI_CACHE_SIZE EMOTION_COUNT
+#else
+#define EMOJI_CACHE_SIZE 4
+#endif
+
+/*
+ * Emoji glyphs pre-rendered into RGB565A8 images, the least recently used one is replaced.
+ *
+ * Showing a cached emotion is a plain image blit, the glyph only goes through the font engine
+ * the first time it is needed. With PSRAM every emotion gets its own image, so each glyph is
+ * rendered once. All calls need the display lock.
+ */
+class EmojiCache {
+public:
+    EmojiCache() = default;
+    ~EmojiCache();
+    EmojiCache(const EmojiCache&) = delete;
+    EmojiCache& operator=(const EmojiCache&) = delete;
+
+    /* `parent` hosts the hidden canvas the glyphs are rendered with */
+    void Init(lv_obj_t* parent, const lv_font_t* font);
+    /* Image of kEmotions[emotion], nullptr if it could not be rendered */
+    const lv_image_dsc_t* Get(int emotion);
+
+private:
+    struct Entry {
+        int emotion = -1;
+        uint32_t last_used = 0;
+        void* data = nullptr;
+        lv_draw_buf_t buf;
+    };
+
+    const lv_font_t* font_ = nullptr;
+    lv_obj_t* canvas_ = nullptr;
+    // ARGB8888 target of the canvas, the pixel data only exists while rendering
+    lv_draw_buf_t scratch_;
+    int32_t size_ = 0;
+    uint32_t clock_ = 0;
+    Entry entries_[EMOJI_CACHE_SIZE];
+
+    bool Render(Entry& entry, int emotion);
+};
+
+#endif // EMOJI_CACHE_H
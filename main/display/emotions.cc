@@ -0,0 +1,79 @@
+#include "emotions.h"
+
+#include <font_awesome_symbols.h>
+
+#include <cstdint>
+#include <cstring>
+
+// FNV-1a seed and table size for which no two emotion names share a slot, checked at compile time
+#define EMOTION_HASH_SEED 11694u
+#define EMOTION_HASH_BITS 5
+
+constexpr Emotion kEmotions[EMOTION_COUNT] = {
+    {"neutral", "😶", FONT_AWESOME_EMOJI_NEUTRAL},
+    {"happy", "🙂", FONT_AWESOME_EMOJI_HAPPY},
+    {"laughing", "😆", FONT_AWESOME_EMOJI_LAUGHING},
+    {"funny", "😂", FONT_AWESOME_EMOJI_FUNNY},
+    {"sad", "😔", FONT_AWESOME_EMOJI_SAD},
+    {"angry", "😠", FONT_AWESOME_EMOJI_ANGRY},
+    {"crying", "😭", FONT_AWESOME_EMOJI_CRYING},
+    {"loving", "😍", FONT_AWESOME_EMOJI_LOVING},
+    {"embarrassed", "😳", FONT_AWESOME_EMOJI_EMBARRASSED},
+    {"surprised", "😯", FONT_AWESOME_EMOJI_SURPRISED},
+    {"shocked", "😱", FONT_AWESOME_EMOJI_SHOCKED},
+    {"thinking", "🤔", FONT_AWESOME_EMOJI_THINKING},
+    {"winking", "😉", FONT_AWESOME_EMOJI_WINKING},
+    {"cool", "😎", FONT_AWESOME_EMOJI_COOL},
+    {"relaxed", "😌", FONT_AWESOME_EMOJI_RELAXED},
+    {"delicious", "🤤", FONT_AWESOME_EMOJI_DELICIOUS},
+    {"kissy", "😘", FONT_AWESOME_EMOJI_KISSY},
+    {"confident", "😏", FONT_AWESOME_EMOJI_CONFIDENT},
+    {"sleepy", "😴", FONT_AWESOME_EMOJI_SLEEPY},
+    {"silly", "😜", FONT_AWESOME_EMOJI_SILLY},
+    {"confused", "🙄", FONT_AWESOME_EMOJI_CONFUSED},
+};
+
+static constexpr int HashSlot(const char* name) {
+    uint32_t hash = EMOTION_HASH_SEED;
+    for (; *name != '\0'; name++) {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+    return hash >> (32 - EMOTION_HASH_BITS);
+}
+
+struct EmotionSlots {
+    int8_t index[1 << EMOTION_HASH_BITS];
+    bool perfect;
+};
+
+static constexpr EmotionSlots BuildSlots() {
+    EmotionSlots slots = {};
+    for (auto& index : slots.index) {
+        index = -1;
+    }
+    slots.perfect = true;
+    for (int i = 0; i < EMOTION_COUNT; i++) {
+        int slot = HashSlot(kEmotions[i].name);
+        if (slots.index[slot] >= 0) {
+            slots.perfect = false;
+        }
+        slots.index[slot] = i;
+    }
+    return slots;
+}
+
+static constexpr EmotionSlots kEmotionSlots = BuildSlots();
+static_assert(kEmotionSlots.perfect, "Emotion names collide, pick another EMOTION_HASH_SEED");
+
+int FindEmotion(const char* name) {
+    if (name == nullptr) {
+        return -1;
+    }
+    // One slot per name, a single compare tells a known emotion from an unknown one
+    int index = kEmotionSlots.index[HashSlot(name)];
+    if (index < 0 || strcmp(kEmotions[index].name, name) != 0) {
+        return -1;
+    }
+    return index;
+}
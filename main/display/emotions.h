@@ -0,0 +1,19 @@
+#ifndef EMOTIONS_H
+#define EMOTIONS_H
+
+#define EMOTION_COUNT 21
+// kEmotions index shown for unknown names
+#define EMOTION_NEUTRAL 0
+
+struct Emotion {
+    const char* name;
+    const char* emoji;  // Drawn with the emoji font
+    const char* icon;   // Font Awesome icon for displays without one
+};
+
+extern const Emotion kEmotions[EMOTION_COUNT];
+
+/* Index of the emotion called `name` in kEmotions, -1 if there is none */
+int FindEmotion(const char* name);
+
+#endif // EMOTIONS_H
@@ -0,0 +1,127 @@
+#include "gif_player.h"
+#include "display_governor.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+
+#define TAG "GifPlayer"
+
+GifPlayer::GifPlayer(lv_obj_t* parent) {
+    image_ = lv_image_create(parent);
+    timer_ = lv_timer_create([](lv_timer_t* timer) {
+        static_cast<GifPlayer*>(lv_timer_get_user_data(timer))->NextFrame();
+    }, GIF_DEFAULT_FRAME_MS, this);
+    lv_timer_pause(timer_);
+}
+
+GifPlayer::~GifPlayer() {
+    Close();
+    lv_timer_delete(timer_);
+    lv_obj_del(image_);
+}
+
+void GifPlayer::Close() {
+    if (gif_ == nullptr) {
+        return;
+    }
+    if (decode_histogram_.count() > 0) {
+        ESP_LOGI(TAG, "%ux%u: %lu frames, decode avg %lums p95 %dms max %lums", gif_->width, gif_->height,
+            decode_histogram_.count(), decode_histogram_.average_us() / 1000,
+            decode_histogram_.PercentileMs(95), decode_histogram_.max_us() / 1000);
+    }
+    lv_timer_pause(timer_);
+    lv_image_cache_drop(&dsc_);
+    gd_close_gif(gif_);
+    gif_ = nullptr;
+    source_ = nullptr;
+}
+
+bool GifPlayer::SetSource(const void* data) {
+    if (data != nullptr && data == source_) {
+        // Already playing, do not restart the animation
+        return true;
+    }
+    Close();
+    decode_histogram_.Reset();
+    if (data == nullptr) {
+        return false;
+    }
+
+    gif_ = gd_open_gif_data(data);
+    if (gif_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to open GIF");
+        return false;
+    }
+    source_ = data;
+    if (loop_count_ >= 0) {
+        gif_->loop_count = loop_count_;
+    }
+
+    dsc_ = {};
+    dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    dsc_.header.cf = LV_COLOR_FORMAT_ARGB8888;
+    dsc_.header.w = gif_->width;
+    dsc_.header.h = gif_->height;
+    dsc_.header.stride = gif_->width * 4;
+    dsc_.data = gif_->canvas;
+    dsc_.data_size = gif_->width * gif_->height * 4;
+
+    // First frame right away so the object has its size before the next layout
+    last_rect_ = {0, 0, gif_->width - 1, gif_->height - 1};
+    NextFrame();
+    lv_image_set_src(image_, &dsc_);
+    lv_timer_resume(timer_);
+    return true;
+}
+
+void GifPlayer::SetLoopCount(int count) {
+    loop_count_ = count;
+    if (gif_ != nullptr) {
+        gif_->loop_count = count;
+    }
+}
+
+void GifPlayer::NextFrame() {
+    if (gif_ == nullptr || lv_obj_has_flag(image_, LV_OBJ_FLAG_HIDDEN)) {
+        return;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    if (gd_get_frame(gif_) == 0) {
+        // Last loop done, keep showing the final frame
+        lv_timer_pause(timer_);
+        lv_obj_send_event(image_, LV_EVENT_READY, nullptr);
+        return;
+    }
+    gd_render_frame(gif_, (uint8_t*)dsc_.data);
+    decode_histogram_.Record(esp_timer_get_time() - start_time);
+
+    lv_image_cache_drop(&dsc_);
+    InvalidateFrame();
+
+    // Frames faster than the display refreshes would be decoded and never shown
+    uint32_t delay_ms = gif_->gce.delay > 0 ? gif_->gce.delay * 10 : GIF_DEFAULT_FRAME_MS;
+    lv_timer_set_period(timer_, std::max<uint32_t>(delay_ms, DISPLAY_ACTIVE_REFR_PERIOD_MS));
+}
+
+void GifPlayer::InvalidateFrame() {
+    // The previous frame is disposed of while this one is decoded, redraw both rectangles
+    lv_area_t rect = {gif_->fx, gif_->fy, gif_->fx + gif_->fw - 1, gif_->fy + gif_->fh - 1};
+    lv_area_t dirty = {
+        std::min(rect.x1, last_rect_.x1), std::min(rect.y1, last_rect_.y1),
+        std::max(rect.x2, last_rect_.x2), std::max(rect.y2, last_rect_.y2),
+    };
+    last_rect_ = rect;
+
+    // Frame coordinates only map onto the screen when the image is shown unscaled at its own size
+    if (lv_obj_get_width(image_) != gif_->width || lv_obj_get_height(image_) != gif_->height) {
+        lv_obj_invalidate(image_);
+        return;
+    }
+    lv_area_t coords;
+    lv_obj_get_coords(image_, &coords);
+    lv_area_t area = {coords.x1 + dirty.x1, coords.y1 + dirty.y1, coords.x1 + dirty.x2, coords.y1 + dirty.y2};
+    lv_obj_invalidate_area(image_, &area);
+}
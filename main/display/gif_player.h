@@ -0,0 +1,56 @@
+#ifndef GIF_PLAYER_H
+#define GIF_PLAYER_H
+
+#include <lvgl.h>
+#include <libs/gif/gifdec.h>
+
+#include <cstdint>
+
+#include "latency_histogram.h"
+
+// Frames with no delay are shown this long, as browsers do
+#define GIF_DEFAULT_FRAME_MS 100
+
+/*
+ * Plays a GIF from memory into an image object, one frame per timer tick.
+ *
+ * Frames are decoded straight from the source bytes, which can be a compiled-in array or a
+ * memory-mapped partition, so only the composited ARGB8888 canvas is allocated (in PSRAM on
+ * boards that have it, through LVGL's C library malloc). Each frame only invalidates the
+ * rectangle it changed, the timer follows the frame delays no faster than the display
+ * refreshes, and nothing is decoded while the image is hidden. All calls need the display lock.
+ */
+class GifPlayer {
+public:
+    explicit GifPlayer(lv_obj_t* parent);
+    ~GifPlayer();
+    GifPlayer(const GifPlayer&) = delete;
+    GifPlayer& operator=(const GifPlayer&) = delete;
+
+    /* Starts playing the GIF in `data`, which must stay valid while it plays */
+    bool SetSource(const void* data);
+    /* GIF from an image descriptor with LV_COLOR_FORMAT_RAW data, as in main/assets/gif */
+    bool SetSource(const lv_image_dsc_t* dsc) { return SetSource(dsc != nullptr ? dsc->data : nullptr); }
+    /* 0 plays forever, kept for later sources. By default the GIF's own count is used */
+    void SetLoopCount(int count);
+
+    lv_obj_t* obj() const { return image_; }
+    /* Decode time of a frame since the source was set */
+    const LatencyHistogram& decode_histogram() const { return decode_histogram_; }
+
+private:
+    lv_obj_t* image_ = nullptr;
+    lv_timer_t* timer_ = nullptr;
+    gd_GIF* gif_ = nullptr;
+    const void* source_ = nullptr;
+    int loop_count_ = -1;
+    lv_image_dsc_t dsc_ = {};
+    lv_area_t last_rect_ = {};
+    LatencyHistogram decode_histogram_;
+
+    void Close();
+    void NextFrame();
+    void InvalidateFrame();
+};
+
+#endif // GIF_PLAYER_H
@@ -1,4 +1,5 @@
 #include "lcd_display.h"
+#include "emotions.h"
 
 #include <vector>
 #include <algorithm>
@@ -106,15 +107,17 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
     port_cfg.task_priority = 0;  // 降低LVGL任务优先级，避免影响网络通信
     port_cfg.timer_period_ms = 100;  // 增加刷新间隔，减少CPU占用
+    port_cfg.task_max_sleep_ms = DISPLAY_TASK_MAX_SLEEP_MS;
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD display");
+    auto buffers = DisplayGovernor::ChooseBuffers(width_, height_, 20, false);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
+        .buffer_size = buffers.buffer_size,
+        .double_buffer = buffers.double_buffer,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -145,6 +148,10 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    lvgl_port_lock(0);
+    governor_.Attach(display_);
+    lvgl_port_unlock();
+
     SetupUI();
 }
 
@@ -168,6 +175,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
     port_cfg.task_priority = 0;  // 降低LVGL任务优先级，避免影响网络通信
     port_cfg.timer_period_ms = 100;  // 增加刷新间隔，减少CPU占用
+    port_cfg.task_max_sleep_ms = DISPLAY_TASK_MAX_SLEEP_MS;
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD display");
@@ -208,6 +216,10 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    lvgl_port_lock(0);
+    governor_.Attach(display_);
+    lvgl_port_unlock();
+
     SetupUI();
 }
 
@@ -226,15 +238,17 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
 
     ESP_LOGI(TAG, "Initialize LVGL port");
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    port_cfg.task_max_sleep_ms = DISPLAY_TASK_MAX_SLEEP_MS;
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD display");
+    auto buffers = DisplayGovernor::ChooseBuffers(width_, height_, 50, true);
     const lvgl_port_display_cfg_t disp_cfg = {
             .io_handle = panel_io,
             .panel_handle = panel,
             .control_handle = nullptr,
-            .buffer_size = static_cast<uint32_t>(width_ * 50),
-            .double_buffer = false,
+            .buffer_size = buffers.buffer_size,
+            .double_buffer = buffers.double_buffer,
             .hres = static_cast<uint32_t>(width_),
             .vres = static_cast<uint32_t>(height_),
             .monochrome = false,
@@ -245,8 +259,8 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
             .mirror_y = mirror_y,
         },
         .flags = {
-            .buff_dma = true,
-            .buff_spiram =false,
+            .buff_dma = !buffers.spiram,
+            .buff_spiram = buffers.spiram,
             .sw_rotate = false,
         },
     };
@@ -266,6 +280,10 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
+    lvgl_port_lock(0);
+    governor_.Attach(display_);
+    lvgl_port_unlock();
+
     SetupUI();
 }
 
@@ -295,6 +313,15 @@ LcdDisplay::~LcdDisplay() {
     }
 }
 
+bool LcdDisplay::GetRefreshStats(DisplayRefreshStats& stats) {
+    // Boards that add the display themselves do not attach the governor
+    if (!governor_.attached()) {
+        return false;
+    }
+    stats = governor_.GetStats();
+    return true;
+}
+
 bool LcdDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -347,8 +374,16 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, 10, 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Chat messages come from a pool of bubbles created on demand in SetChatMessage
     chat_message_label_ = nullptr;
+    InitChatStyles();
+    lv_obj_add_event_cb(content_, [](lv_event_t* e) {
+        // Scrolled up to the oldest laid out message, bring back the hidden history
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        if (lv_obj_get_scroll_top(self->content_) <= 0) {
+            self->ShowChatHistory();
+        }
+    }, LV_EVENT_SCROLL_END, this);
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -370,6 +405,12 @@ void LcdDisplay::SetupUI() {
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
     lv_obj_set_style_margin_right(emotion_label_, 5, 0); // 添加右边距，与后面的元素分隔
 
+    // 预渲染的表情图片与emotion_label_占同一位置，二者只显示一个
+    emotion_image_ = lv_image_create(status_bar_);
+    lv_obj_set_style_margin_right(emotion_image_, 5, 0);
+    lv_obj_add_flag(emotion_image_, LV_OBJ_FLAG_HIDDEN);
+    emoji_cache_.Init(status_bar_, fonts_.emoji_font);
+
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
     lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
@@ -418,6 +459,107 @@ void LcdDisplay::SetupUI() {
 #else
 #define  MAX_MESSAGES 20
 #endif
+void LcdDisplay::InitChatStyles() {
+    lv_style_init(&chat_row_style_);
+    lv_style_set_width(&chat_row_style_, LV_HOR_RES);
+    lv_style_set_height(&chat_row_style_, LV_SIZE_CONTENT);
+    lv_style_set_bg_opa(&chat_row_style_, LV_OPA_TRANSP);
+    lv_style_set_border_width(&chat_row_style_, 0);
+    lv_style_set_pad_all(&chat_row_style_, 0);
+
+    lv_style_init(&chat_bubble_style_);
+    lv_style_set_radius(&chat_bubble_style_, 8);
+    lv_style_set_border_width(&chat_bubble_style_, 1);
+    lv_style_set_pad_all(&chat_bubble_style_, 8);
+    lv_style_set_height(&chat_bubble_style_, LV_SIZE_CONTENT);
+    lv_style_set_width(&chat_bubble_style_, LV_SIZE_CONTENT);
+
+    // 气泡宽度跟随文本，限制在最小宽度和屏幕宽度的85%之间，由布局计算，不再逐条测量文本
+    lv_style_init(&chat_label_style_);
+    lv_style_set_width(&chat_label_style_, LV_SIZE_CONTENT);
+    lv_style_set_min_width(&chat_label_style_, 20);
+    lv_style_set_max_width(&chat_label_style_, LV_HOR_RES * 85 / 100 - 16);
+
+    for (auto style : {&user_bubble_style_, &assistant_bubble_style_, &system_bubble_style_,
+                       &chat_text_style_, &system_text_style_}) {
+        lv_style_init(style);
+    }
+    lv_style_set_text_font(&chat_text_style_, fonts_.text_font);
+    lv_style_set_text_font(&system_text_style_, fonts_.text_font);
+    UpdateChatStyles();
+}
+
+void LcdDisplay::UpdateChatStyles() {
+    lv_style_set_border_color(&chat_bubble_style_, current_theme_.border);
+    lv_style_set_bg_color(&user_bubble_style_, current_theme_.user_bubble);
+    lv_style_set_bg_color(&assistant_bubble_style_, current_theme_.assistant_bubble);
+    lv_style_set_bg_color(&system_bubble_style_, current_theme_.system_bubble);
+    lv_style_set_text_color(&chat_text_style_, current_theme_.text);
+    lv_style_set_text_color(&system_text_style_, current_theme_.system_text);
+    // Every bubble using the styles is refreshed at once
+    lv_obj_report_style_change(nullptr);
+}
+
+LcdDisplay::ChatBubble& LcdDisplay::AcquireChatBubble() {
+    if (chat_bubbles_.size() < MAX_MESSAGES) {
+        ChatBubble bubble;
+        bubble.row = lv_obj_create(content_);
+        lv_obj_add_style(bubble.row, &chat_row_style_, 0);
+        lv_obj_set_scrollbar_mode(bubble.row, LV_SCROLLBAR_MODE_OFF);
+        bubble.bubble = lv_obj_create(bubble.row);
+        lv_obj_add_style(bubble.bubble, &chat_bubble_style_, 0);
+        lv_obj_set_scrollbar_mode(bubble.bubble, LV_SCROLLBAR_MODE_OFF);
+        bubble.label = lv_label_create(bubble.bubble);
+        lv_obj_add_style(bubble.label, &chat_label_style_, 0);
+        lv_label_set_long_mode(bubble.label, LV_LABEL_LONG_WRAP);
+        chat_bubbles_.push_back(bubble);
+        return chat_bubbles_.back();
+    }
+
+    // Recycle the oldest bubble in place as the newest message
+    auto& bubble = chat_bubbles_[chat_bubble_head_];
+    chat_bubble_head_ = (chat_bubble_head_ + 1) % chat_bubbles_.size();
+    lv_obj_move_to_index(bubble.row, -1);
+    lv_obj_clear_flag(bubble.row, LV_OBJ_FLAG_HIDDEN);
+    return bubble;
+}
+
+LcdDisplay::ChatBubble* LcdDisplay::GetLastChatBubble() {
+    if (chat_bubbles_.empty()) {
+        return nullptr;
+    }
+    size_t count = chat_bubbles_.size();
+    return &chat_bubbles_[(chat_bubble_head_ + count - 1) % count];
+}
+
+void LcdDisplay::HideOffscreenChatBubbles() {
+    // Hidden rows are skipped by the flex layout, keep about two screens of history laid out.
+    // The new message has no height until the layout runs
+    lv_obj_update_layout(content_);
+    int32_t budget = lv_obj_get_content_height(content_) * 2;
+    int32_t height = 0;
+    size_t count = chat_bubbles_.size();
+    for (size_t i = 0; i < count; i++) {
+        auto& bubble = chat_bubbles_[(chat_bubble_head_ + count - 1 - i) % count];
+        if (height > budget) {
+            lv_obj_add_flag(bubble.row, LV_OBJ_FLAG_HIDDEN);
+            chat_history_hidden_ = true;
+        } else {
+            height += lv_obj_get_height(bubble.row);
+        }
+    }
+}
+
+void LcdDisplay::ShowChatHistory() {
+    if (!chat_history_hidden_) {
+        return;
+    }
+    chat_history_hidden_ = false;
+    for (auto& bubble : chat_bubbles_) {
+        lv_obj_clear_flag(bubble.row, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
@@ -426,281 +568,140 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     
     //避免出现空的消息框
     if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
-    }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0 && child_count > 0) {
-        // 获取最后一个消息容器
-        lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-        if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-            // 获取容器内的气泡
-            lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-            if (last_bubble != nullptr) {
-                // 检查气泡类型是否为系统消息
-                void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                    // 如果最后一个消息也是系统消息，则删除它
-                    lv_obj_del(last_container);
-                }
-            }
-        }
-    }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme_.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
 
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
+    // Image previews are not pooled, drop the oldest one once the chat is full
+    lv_obj_t* first_child = lv_obj_get_child(content_, 0);
+    if (lv_obj_get_child_cnt(content_) >= MAX_MESSAGES && first_child != nullptr &&
+        lv_obj_get_user_data(first_child) != nullptr && strcmp((const char*)lv_obj_get_user_data(first_child), "image") == 0) {
+        lv_obj_del(first_child);
     }
 
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
+    bool is_user = strcmp(role, "user") == 0;
+    bool is_system = strcmp(role, "system") == 0;
+
+    // 折叠系统消息（如果最后一个消息也是系统消息，则直接复用它）
+    ChatBubble* bubble = nullptr;
+    auto last = GetLastChatBubble();
+    if (is_system && last != nullptr && last->system &&
+        lv_obj_get_index(last->row) == (int32_t)lv_obj_get_child_cnt(content_) - 1) {
+        bubble = last;
     } else {
-        bubble_width = max_width;
+        bubble = &AcquireChatBubble();
     }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.assistant_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.system_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+    lv_label_set_text(bubble->label, content);
+
+    // Swap the shared role styles, nothing is styled per object
+    const lv_style_t* role_style = is_user ? &user_bubble_style_ : is_system ? &system_bubble_style_ : &assistant_bubble_style_;
+    if (bubble->role_style != role_style) {
+        if (bubble->role_style != nullptr) {
+            lv_obj_remove_style(bubble->bubble, (lv_style_t*)bubble->role_style, 0);
+            lv_obj_remove_style(bubble->label, bubble->system ? &system_text_style_ : &chat_text_style_, 0);
+        }
+        lv_obj_add_style(bubble->bubble, (lv_style_t*)role_style, 0);
+        lv_obj_add_style(bubble->label, is_system ? &system_text_style_ : &chat_text_style_, 0);
+        bubble->role_style = role_style;
+        bubble->system = is_system;
+    }
+
+    // 设置自定义属性标记气泡类型
+    lv_obj_set_user_data(bubble->bubble, (void*)(is_user ? "user" : is_system ? "system" : "assistant"));
+    if (is_user) {
+        lv_obj_align(bubble->bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (is_system) {
+        lv_obj_align(bubble->bubble, LV_ALIGN_CENTER, 0, 0);
+    } else {
+        lv_obj_align(bubble->bubble, LV_ALIGN_LEFT_MID, 0, 0);
     }
-    
+
+    HideOffscreenChatBubbles();
+
+    // Auto-scroll to the new message
+    lv_obj_scroll_to_view_recursive(bubble->row, LV_ANIM_ON);
+
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = bubble->label;
 }
 
 void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
+    if (img_dsc == nullptr || img_dsc->header.cf != LV_COLOR_FORMAT_RGB565) {
         return;
     }
-    
-    if (img_dsc != nullptr) {
-        // Create a message bubble for image preview
-        lv_obj_t* img_bubble = lv_obj_create(content_);
-        lv_obj_set_style_radius(img_bubble, 8, 0);
-        lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
-        lv_obj_set_style_border_width(img_bubble, 1, 0);
-        lv_obj_set_style_border_color(img_bubble, current_theme_.border, 0);
-        lv_obj_set_style_pad_all(img_bubble, 8, 0);
-        
-        // Set image bubble background color (similar to system message)
-        lv_obj_set_style_bg_color(img_bubble, current_theme_.assistant_bubble, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(img_bubble, (void*)"image");
-        
-        // Create the image object inside the bubble
-        lv_obj_t* preview_image = lv_image_create(img_bubble);
-        
-        // Copy the image descriptor and data to avoid source data changes
-        lv_img_dsc_t* copied_img_dsc = (lv_img_dsc_t*)heap_caps_malloc(sizeof(lv_img_dsc_t), MALLOC_CAP_8BIT);
-        if (copied_img_dsc == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for image descriptor");
-            lv_obj_del(img_bubble);
-            return;
-        }
-        
-        // Copy the header
-        copied_img_dsc->header = img_dsc->header;
-        copied_img_dsc->data_size = img_dsc->data_size;
-        
-        // Copy the image data
-        uint8_t* copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (copied_data == nullptr) {
-            // Fallback to internal RAM if SPIRAM allocation fails
-            copied_data = (uint8_t*)heap_caps_malloc(img_dsc->data_size, MALLOC_CAP_8BIT);
-        }
-        if (copied_data == nullptr) {
-            ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %lu bytes)", img_dsc->data_size);
-            heap_caps_free(copied_img_dsc);
-            lv_obj_del(img_bubble);
-            return;
-        }
-        
-        memcpy(copied_data, img_dsc->data, img_dsc->data_size);
-        copied_img_dsc->data = copied_data;
-        
-        // Calculate appropriate size for the image
-        lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
-        lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
-        
-        // Calculate zoom factor to fit within maximum dimensions
-        lv_coord_t img_width = copied_img_dsc->header.w;
-        lv_coord_t img_height = copied_img_dsc->header.h;
-        
-        lv_coord_t zoom_w = (max_width * 256) / img_width;
-        lv_coord_t zoom_h = (max_height * 256) / img_height;
-        lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
-        
-        // Ensure zoom doesn't exceed 256 (100%)
-        if (zoom > 256) zoom = 256;
-        
-        // Set image properties
-        lv_image_set_src(preview_image, copied_img_dsc);
-        lv_image_set_scale(preview_image, zoom);
-        
-        // Add event handler to clean up copied data when image is deleted
-        lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
-            lv_img_dsc_t* copied_img_dsc = (lv_img_dsc_t*)lv_event_get_user_data(e);
-            if (copied_img_dsc != nullptr) {
-                heap_caps_free((void*)copied_img_dsc->data);
-                heap_caps_free(copied_img_dsc);
-            }
-        }, LV_EVENT_DELETE, (void*)copied_img_dsc);
-        
-        // Calculate actual scaled image dimensions
-        lv_coord_t scaled_width = (img_width * zoom) / 256;
-        lv_coord_t scaled_height = (img_height * zoom) / 256;
-        
-        // Set bubble size to be 16 pixels larger than the image (8 pixels on each side)
-        lv_obj_set_width(img_bubble, scaled_width + 16);
-        lv_obj_set_height(img_bubble, scaled_height + 16);
-        
-        // Don't grow in flex layout
-        lv_obj_set_style_flex_grow(img_bubble, 0, 0);
-        
-        // Center the image within the bubble
-        lv_obj_center(preview_image);
-        
-        // Left align the image bubble like assistant messages
-        lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    // Copy the image data to avoid source data changes
+    auto image = PreviewImage::Create(img_dsc->header.w, img_dsc->header.h);
+    if (image == nullptr) {
+        return;
+    }
+    memcpy(image->data(), img_dsc->data, std::min<size_t>(img_dsc->data_size, image->size()));
+    SetSharedPreviewImage(std::move(image));
+}
 
-        // Auto-scroll to the image bubble
-        lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
+void LcdDisplay::SetSharedPreviewImage(std::shared_ptr<PreviewImage> image) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr || image == nullptr) {
+        return;
     }
+
+    // Create a message bubble for image preview
+    lv_obj_t* img_bubble = lv_obj_create(content_);
+    lv_obj_set_style_radius(img_bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(img_bubble, 1, 0);
+    lv_obj_set_style_border_color(img_bubble, current_theme_.border, 0);
+    lv_obj_set_style_pad_all(img_bubble, 8, 0);
+
+    // Set image bubble background color (similar to system message)
+    lv_obj_set_style_bg_color(img_bubble, current_theme_.assistant_bubble, 0);
+
+    // 设置自定义属性标记气泡类型
+    lv_obj_set_user_data(img_bubble, (void*)"image");
+
+    // Create the image object inside the bubble
+    lv_obj_t* preview_image = lv_image_create(img_bubble);
+
+    // Calculate appropriate size for the image
+    lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
+    lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
+
+    // Calculate zoom factor to fit within maximum dimensions
+    lv_coord_t img_width = image->dsc()->header.w;
+    lv_coord_t img_height = image->dsc()->header.h;
+
+    lv_coord_t zoom_w = (max_width * 256) / img_width;
+    lv_coord_t zoom_h = (max_height * 256) / img_height;
+    lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
+
+    // Ensure zoom doesn't exceed 256 (100%)
+    if (zoom > 256) zoom = 256;
+
+    // Set image properties
+    lv_image_set_src(preview_image, image->dsc());
+    lv_image_set_scale(preview_image, zoom);
+
+    // The bubble holds a reference to the image until it is deleted
+    lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
+        delete static_cast<std::shared_ptr<PreviewImage>*>(lv_event_get_user_data(e));
+    }, LV_EVENT_DELETE, new std::shared_ptr<PreviewImage>(std::move(image)));
+
+    // Calculate actual scaled image dimensions
+    lv_coord_t scaled_width = (img_width * zoom) / 256;
+    lv_coord_t scaled_height = (img_height * zoom) / 256;
+
+    // Set bubble size to be 16 pixels larger than the image (8 pixels on each side)
+    lv_obj_set_width(img_bubble, scaled_width + 16);
+    lv_obj_set_height(img_bubble, scaled_height + 16);
+
+    // Don't grow in flex layout
+    lv_obj_set_style_flex_grow(img_bubble, 0, 0);
+
+    // Center the image within the bubble
+    lv_obj_center(preview_image);
+
+    // Left align the image bubble like assistant messages
+    lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+
+    // Auto-scroll to the image bubble
+    lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
 }
 #else
 void LcdDisplay::SetupUI() {
@@ -746,6 +747,11 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(emotion_label_, current_theme_.text, 0);
     lv_label_set_text(emotion_label_, FONT_AWESOME_AI_CHIP);
 
+    // 预渲染的表情图片与emotion_label_占同一位置，二者只显示一个
+    emotion_image_ = lv_image_create(content_);
+    lv_obj_add_flag(emotion_image_, LV_OBJ_FLAG_HIDDEN);
+    emoji_cache_.Init(content_, fonts_.emoji_font);
+
     preview_image_ = lv_image_create(content_);
     lv_obj_set_size(preview_image_, width_ * 0.5, height_ * 0.5);
     lv_obj_align(preview_image_, LV_ALIGN_CENTER, 0, 0);
@@ -819,75 +825,67 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
         // 设置图片源并显示预览图片
         lv_image_set_src(preview_image_, img_dsc);
         lv_obj_clear_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
-        // 隐藏emotion_label_
+        // 隐藏表情
         if (emotion_label_ != nullptr) {
-            lv_obj_add_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+            ShowEmotion(false);
         }
     } else {
-        // 隐藏预览图片并显示emotion_label_
+        // 隐藏预览图片并显示表情
         lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
         if (emotion_label_ != nullptr) {
-            lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+            ShowEmotion(true);
         }
     }
 }
 #endif
 
 void LcdDisplay::SetEmotion(const char* emotion) {
-    struct Emotion {
-        const char* icon;
-        const char* text;
-    };
-
-    static const std::vector<Emotion> emotions = {
-        {"😶", "neutral"},
-        {"🙂", "happy"},
-        {"😆", "laughing"},
-        {"😂", "funny"},
-        {"😔", "sad"},
-        {"😠", "angry"},
-        {"😭", "crying"},
-        {"😍", "loving"},
-        {"😳", "embarrassed"},
-        {"😯", "surprised"},
-        {"😱", "shocked"},
-        {"🤔", "thinking"},
-        {"😉", "winking"},
-        {"😎", "cool"},
-        {"😌", "relaxed"},
-        {"🤤", "delicious"},
-        {"😘", "kissy"},
-        {"😏", "confident"},
-        {"😴", "sleepy"},
-        {"😜", "silly"},
-        {"🙄", "confused"}
-    };
-    
-    // 查找匹配的表情
-    std::string_view emotion_view(emotion);
-    auto it = std::find_if(emotions.begin(), emotions.end(),
-        [&emotion_view](const Emotion& e) { return e.text == emotion_view; });
+    int index = FindEmotion(emotion);
+    if (index < 0) {
+        index = EMOTION_NEUTRAL;
+    }
 
     DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr) {
         return;
     }
 
-    // 如果找到匹配的表情就显示对应图标，否则显示默认的neutral表情
-    lv_obj_set_style_text_font(emotion_label_, fonts_.emoji_font, 0);
-    if (it != emotions.end()) {
-        lv_label_set_text(emotion_label_, it->icon);
+    // 优先显示预渲染的表情图片，内存不足时退回到字体渲染
+    auto image = emotion_image_ != nullptr ? emoji_cache_.Get(index) : nullptr;
+    if (image != nullptr) {
+        lv_image_set_src(emotion_image_, image);
     } else {
-        lv_label_set_text(emotion_label_, "😶");
+        lv_obj_set_style_text_font(emotion_label_, fonts_.emoji_font, 0);
+        lv_label_set_text(emotion_label_, kEmotions[index].emoji);
     }
+    emotion_image_shown_ = image != nullptr;
 
 #if !CONFIG_USE_WECHAT_MESSAGE_STYLE
-    // 显示emotion_label_，隐藏preview_image_
-    lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    // 隐藏preview_image_
     if (preview_image_ != nullptr) {
         lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
     }
 #endif
+    ShowEmotion(true);
+}
+
+void LcdDisplay::ShowEmotion(bool visible) {
+    if (emotion_image_ == nullptr) {
+        emotion_image_shown_ = false;
+    }
+    if (visible && !emotion_image_shown_) {
+        lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+    if (emotion_image_ == nullptr) {
+        return;
+    }
+    if (visible && emotion_image_shown_) {
+        lv_obj_clear_flag(emotion_image_, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(emotion_image_, LV_OBJ_FLAG_HIDDEN);
+    }
 }
 
 void LcdDisplay::SetIcon(const char* icon) {
@@ -897,14 +895,15 @@ void LcdDisplay::SetIcon(const char* icon) {
     }
     lv_obj_set_style_text_font(emotion_label_, &font_awesome_30_4, 0);
     lv_label_set_text(emotion_label_, icon);
+    emotion_image_shown_ = false;
 
 #if !CONFIG_USE_WECHAT_MESSAGE_STYLE
-    // 显示emotion_label_，隐藏preview_image_
-    lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    // 隐藏preview_image_
     if (preview_image_ != nullptr) {
         lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
     }
 #endif
+    ShowEmotion(true);
 }
 
 void LcdDisplay::SetTheme(const std::string& theme_name) {
@@ -966,119 +965,15 @@ void LcdDisplay::SetTheme(const std::string& theme_name) {
         
         // If we have the chat message style, update all message bubbles
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
-        // Iterate through all children of content (message containers or bubbles)
+        // Pooled bubbles follow the shared styles, image previews are styled per object
+        UpdateChatStyles();
         uint32_t child_count = lv_obj_get_child_cnt(content_);
         for (uint32_t i = 0; i < child_count; i++) {
             lv_obj_t* obj = lv_obj_get_child(content_, i);
-            if (obj == nullptr) continue;
-            
-            lv_obj_t* bubble = nullptr;
-            
-            // 检查这个对象是容器还是气泡
-            // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-            // 如果是气泡（助手消息），则直接使用
-            if (lv_obj_get_child_cnt(obj) > 0) {
-                // 可能是容器，检查它是否为用户或系统消息容器
-                // 用户和系统消息容器是透明的
-                lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-                if (bg_opa == LV_OPA_TRANSP) {
-                    // 这是用户或系统消息的容器
-                    bubble = lv_obj_get_child(obj, 0);
-                } else {
-                    // 这可能是助手消息的气泡自身
-                    bubble = obj;
-                }
-            } else {
-                // 没有子元素，可能是其他UI元素，跳过
-                continue;
-            }
-            
-            if (bubble == nullptr) continue;
-            
-            // 使用保存的用户数据来识别气泡类型
-            void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-            if (bubble_type_ptr != nullptr) {
-                const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-                
-                // 根据气泡类型应用正确的颜色
-                if (strcmp(bubble_type, "user") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (strcmp(bubble_type, "assistant") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0); 
-                } else if (strcmp(bubble_type, "system") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                } else if (strcmp(bubble_type, "image") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 根据气泡类型设置文本颜色
-                        if (strcmp(bubble_type, "system") == 0) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
-            } else {
-                // 如果没有标记，回退到之前的逻辑（颜色比较）
-                // ...保留原有的回退逻辑...
-                lv_color_t bg_color = lv_obj_get_style_bg_color(bubble, 0);
-            
-                // 改进bubble类型检测逻辑，不仅使用颜色比较
-                bool is_user_bubble = false;
-                bool is_assistant_bubble = false;
-                bool is_system_bubble = false;
-            
-                // 检查用户bubble
-                if (lv_color_eq(bg_color, DARK_USER_BUBBLE_COLOR) || 
-                    lv_color_eq(bg_color, LIGHT_USER_BUBBLE_COLOR) ||
-                    lv_color_eq(bg_color, current_theme_.user_bubble)) {
-                    is_user_bubble = true;
-                }
-                // 检查系统bubble
-                else if (lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                         lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR) ||
-                         lv_color_eq(bg_color, current_theme_.system_bubble)) {
-                    is_system_bubble = true;
-                }
-                // 剩余的都当作助手bubble处理
-                else {
-                    is_assistant_bubble = true;
-                }
-            
-                // 根据bubble类型应用正确的颜色
-                if (is_user_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (is_assistant_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0);
-                } else if (is_system_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 回退到颜色检测逻辑
-                        if (lv_color_eq(bg_color, current_theme_.system_bubble) ||
-                            lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                            lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR)) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
+            void* bubble_type_ptr = lv_obj_get_user_data(obj);
+            if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "image") == 0) {
+                lv_obj_set_style_bg_color(obj, current_theme_.system_bubble, 0);
+                lv_obj_set_style_border_color(obj, current_theme_.border, 0);
             }
         }
 #else
@@ -2,12 +2,15 @@
 #define LCD_DISPLAY_H
 
 #include "display.h"
+#include "display_governor.h"
+#include "emoji_cache.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 #include <font_emoji.h>
 
 #include <atomic>
+#include <vector>
 
 // Theme color structure
 struct ThemeColors {
@@ -34,11 +37,46 @@ protected:
     lv_obj_t* container_ = nullptr;
     lv_obj_t* side_bar_ = nullptr;
     lv_obj_t* preview_image_ = nullptr;
+    lv_obj_t* emotion_image_ = nullptr;
+    bool emotion_image_shown_ = false;
+    EmojiCache emoji_cache_;
 
     DisplayFonts fonts_;
     ThemeColors current_theme_;
+    DisplayGovernor governor_;
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // A pooled chat message: a transparent full-width row that aligns the bubble, and its label
+    struct ChatBubble {
+        lv_obj_t* row = nullptr;
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        const lv_style_t* role_style = nullptr;
+        bool system = false;
+    };
+    std::vector<ChatBubble> chat_bubbles_;  // Ring of up to MAX_MESSAGES, the oldest at chat_bubble_head_
+    size_t chat_bubble_head_ = 0;
+    bool chat_history_hidden_ = false;
+    lv_style_t chat_row_style_;
+    lv_style_t chat_bubble_style_;
+    lv_style_t chat_label_style_;
+    lv_style_t user_bubble_style_;
+    lv_style_t assistant_bubble_style_;
+    lv_style_t system_bubble_style_;
+    lv_style_t chat_text_style_;
+    lv_style_t system_text_style_;
+
+    void InitChatStyles();
+    void UpdateChatStyles();
+    ChatBubble& AcquireChatBubble();
+    ChatBubble* GetLastChatBubble();
+    void HideOffscreenChatBubbles();
+    void ShowChatHistory();
+#endif
 
     void SetupUI();
+    /* Shows or hides whichever of emotion_label_ and emotion_image_ holds the current emotion */
+    void ShowEmotion(bool visible);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -53,10 +91,12 @@ public:
     virtual void SetPreviewImage(const lv_img_dsc_t* img_dsc) override;
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
     virtual void SetChatMessage(const char* role, const char* content) override; 
+    virtual void SetSharedPreviewImage(std::shared_ptr<PreviewImage> image) override;
 #endif  
 
     // Add theme switching function
     virtual void SetTheme(const std::string& theme_name) override;
+    virtual bool GetRefreshStats(DisplayRefreshStats& stats) override;
 };
 
 // RGB LCD显示器
@@ -0,0 +1,36 @@
+#include "preview_image.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#define TAG "PreviewImage"
+
+std::shared_ptr<PreviewImage> PreviewImage::Create(uint32_t width, uint32_t height) {
+    size_t size = width * height * 2;
+    auto data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (data == nullptr) {
+        // Fallback to internal RAM if SPIRAM allocation fails
+        data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for image data (size: %u bytes)", size);
+        return nullptr;
+    }
+
+    std::shared_ptr<PreviewImage> image(new PreviewImage());
+    image->data_ = data;
+    image->dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    image->dsc_.header.cf = LV_COLOR_FORMAT_RGB565;
+    image->dsc_.header.w = width;
+    image->dsc_.header.h = height;
+    image->dsc_.header.stride = width * 2;
+    image->dsc_.data_size = size;
+    image->dsc_.data = data;
+    return image;
+}
+
+PreviewImage::~PreviewImage() {
+    // LVGL may still hold a decoded entry for the old pixels
+    lv_image_cache_drop(&dsc_);
+    heap_caps_free(data_);
+}
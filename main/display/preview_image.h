@@ -0,0 +1,36 @@
+#ifndef PREVIEW_IMAGE_H
+#define PREVIEW_IMAGE_H
+
+#include <lvgl.h>
+
+#include <cstdint>
+#include <memory>
+
+/*
+ * An RGB565 image buffer shared by reference between a producer (the camera) and the display.
+ *
+ * The display keeps a reference for as long as the image is on screen, so the producer may
+ * only write into a buffer nobody else holds (use_count() == 1). The camera alternates between
+ * two buffers and only allocates when the display holds both. No pixels are copied on the way
+ * to the screen.
+ */
+class PreviewImage {
+public:
+    /* nullptr if the buffer cannot be allocated, PSRAM is preferred */
+    static std::shared_ptr<PreviewImage> Create(uint32_t width, uint32_t height);
+    ~PreviewImage();
+    PreviewImage(const PreviewImage&) = delete;
+    PreviewImage& operator=(const PreviewImage&) = delete;
+
+    const lv_image_dsc_t* dsc() const { return &dsc_; }
+    uint8_t* data() { return data_; }
+    size_t size() const { return dsc_.data_size; }
+
+private:
+    PreviewImage() = default;
+
+    lv_image_dsc_t dsc_ = {};
+    uint8_t* data_ = nullptr;
+};
+
+#endif // PREVIEW_IMAGE_H
@@ -0,0 +1,129 @@
+#include "main_task_queue.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "MainTaskQueue"
+
+// Tasks running longer than this block every other event of the main loop
+#define MAIN_TASK_SLOW_US (100 * 1000)
+
+static const char* const kPriorityNames[kMainTaskPriorityCount] = {"control", "audio", "ui"};
+
+MainTaskQueue::MainTaskQueue(size_t capacity) : slots_(capacity) {
+    for (size_t i = 0; i < capacity; i++) {
+        slots_[i].next = i + 1 < capacity ? (int)(i + 1) : -1;
+    }
+    free_head_ = capacity > 0 ? 0 : -1;
+    for (int i = 0; i < kMainTaskPriorityCount; i++) {
+        head_[i] = -1;
+        tail_[i] = -1;
+    }
+    stats_.capacity = capacity;
+}
+
+void MainTaskQueue::Push(MainTask&& task, MainTaskPriority priority, uint32_t deadline_ms, MainTaskOrder order) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_head_ < 0) {
+        // Counted fallback: growing the array reallocates it and moves every queued task while
+        // the mutex is held, so the capacity should be sized for this never to happen
+        stats_.overflows++;
+        ESP_LOGW(TAG, "All %u slots taken, growing the queue", (unsigned)slots_.size());
+        free_head_ = slots_.size();
+        slots_.emplace_back();
+    }
+    if (!task.is_inline()) {
+        stats_.heap_tasks++;
+    }
+
+    int index = free_head_;
+    auto& slot = slots_[index];
+    free_head_ = slot.next;
+    slot.task = std::move(task);
+    slot.queued_us = now;
+    slot.deadline_us = deadline_ms > 0 ? now + deadline_ms * 1000LL : 0;
+    slot.sequence = next_sequence_++;
+    slot.after_queued = order == kMainTaskAfterQueued;
+    slot.next = -1;
+
+    if (tail_[priority] < 0) {
+        head_[priority] = index;
+    } else {
+        slots_[tail_[priority]].next = index;
+    }
+    tail_[priority] = index;
+
+    size_++;
+    if (size_ > stats_.high_water) {
+        stats_.high_water = size_;
+    }
+}
+
+bool MainTaskQueue::RunNext() {
+    MainTask task;
+    int priority = 0;
+    int64_t queued_us;
+    int64_t deadline_us;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (priority < kMainTaskPriorityCount && head_[priority] < 0) {
+            priority++;
+        }
+        if (priority == kMainTaskPriorityCount) {
+            return false;
+        }
+        if (slots_[head_[priority]].after_queued) {
+            // Let the older tasks of the lower classes go first, oldest first. Sequence numbers
+            // are compared by their difference, so the wrap around does not matter
+            int oldest = priority;
+            for (int i = priority + 1; i < kMainTaskPriorityCount; i++) {
+                if (head_[i] >= 0 && (int32_t)(slots_[head_[i]].sequence - slots_[head_[oldest]].sequence) < 0) {
+                    oldest = i;
+                }
+            }
+            priority = oldest;
+        }
+
+        int index = head_[priority];
+        auto& slot = slots_[index];
+        head_[priority] = slot.next;
+        if (head_[priority] < 0) {
+            tail_[priority] = -1;
+        }
+        task = std::move(slot.task);
+        queued_us = slot.queued_us;
+        deadline_us = slot.deadline_us;
+        slot.next = free_head_;
+        free_head_ = index;
+        size_--;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    if (deadline_us > 0 && start_time > deadline_us) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.deadline_misses[priority]++;
+    }
+    wait_histograms_[priority].Record(start_time - queued_us);
+
+    task();
+
+    int64_t duration = esp_timer_get_time() - start_time;
+    execution_histograms_[priority].Record(duration);
+    if (duration > MAIN_TASK_SLOW_US) {
+        ESP_LOGW(TAG, "Slow %s task: %lld ms", kPriorityNames[priority], (long long)(duration / 1000));
+    }
+    return true;
+}
+
+size_t MainTaskQueue::Size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+MainTaskQueueStats MainTaskQueue::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.capacity = slots_.size();
+    return stats;
+}
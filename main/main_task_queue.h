@@ -0,0 +1,188 @@
+#ifndef MAIN_TASK_QUEUE_H
+#define MAIN_TASK_QUEUE_H
+
+#include <mutex>
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+#include "latency_histogram.h"
+
+/* Tasks of a higher class (lower value) always run before queued tasks of a lower class */
+enum MainTaskPriority {
+    kMainTaskControl,   // State transitions, abort, channel open / close
+    kMainTaskAudio,     // Uplink parameters, link reports
+    kMainTaskUi,        // Chat messages, emotions
+    kMainTaskPriorityCount,
+};
+
+/* Whether a task may overtake the queued tasks of lower classes */
+enum MainTaskOrder {
+    kMainTaskOvertake,
+    kMainTaskAfterQueued,   // Runs after every task queued before it, e.g. a state change that repaints the display
+};
+
+/*
+ * Move-only void() callable with inline storage.
+ *
+ * A callable that fits kInlineSize (`this` plus a couple of pointers and a std::string on the
+ * 32-bit targets) is stored in place, so scheduling it does not touch the heap. Larger ones
+ * fall back to a heap allocation, which is_inline() reports.
+ */
+class MainTask {
+public:
+    static constexpr size_t kInlineSize = 40;
+
+    MainTask() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, MainTask>>>
+    MainTask(F&& callback) {
+        using Callable = std::decay_t<F>;
+        if constexpr (sizeof(Callable) <= kInlineSize && alignof(Callable) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<Callable>) {
+            new (storage_) Callable(std::forward<F>(callback));
+            ops_ = &InlineOps<Callable>::kOps;
+        } else {
+            *reinterpret_cast<Callable**>(storage_) = new Callable(std::forward<F>(callback));
+            ops_ = &HeapOps<Callable>::kOps;
+        }
+    }
+
+    MainTask(MainTask&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    MainTask& operator=(MainTask&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    MainTask(const MainTask&) = delete;
+    MainTask& operator=(const MainTask&) = delete;
+
+    ~MainTask() {
+        Reset();
+    }
+
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    bool is_inline() const { return ops_ == nullptr || !ops_->heap; }
+
+    void Reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*relocate)(void* to, void* from);  // Moves into `to` and destroys `from`
+        void (*destroy)(void* storage);
+        bool heap;
+    };
+
+    template <typename Callable>
+    struct InlineOps {
+        static void Invoke(void* storage) { (*static_cast<Callable*>(storage))(); }
+        static void Relocate(void* to, void* from) {
+            new (to) Callable(std::move(*static_cast<Callable*>(from)));
+            static_cast<Callable*>(from)->~Callable();
+        }
+        static void Destroy(void* storage) { static_cast<Callable*>(storage)->~Callable(); }
+        static constexpr Ops kOps = {Invoke, Relocate, Destroy, false};
+    };
+
+    template <typename Callable>
+    struct HeapOps {
+        static void Invoke(void* storage) { (**static_cast<Callable**>(storage))(); }
+        static void Relocate(void* to, void* from) { *static_cast<Callable**>(to) = *static_cast<Callable**>(from); }
+        static void Destroy(void* storage) { delete *static_cast<Callable**>(storage); }
+        static constexpr Ops kOps = {Invoke, Relocate, Destroy, true};
+    };
+
+    void MoveFrom(MainTask& other) {
+        ops_ = other.ops_;
+        if (ops_ != nullptr) {
+            ops_->relocate(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_ = nullptr;
+};
+
+struct MainTaskQueueStats {
+    size_t capacity = 0;
+    size_t high_water = 0;      // Peak number of queued tasks
+    uint32_t overflows = 0;     // Push() found every slot taken and grew the slot array
+    uint32_t heap_tasks = 0;    // Callables too large for the inline storage
+    uint32_t deadline_misses[kMainTaskPriorityCount] = {};
+};
+
+/*
+ * Task queue of the main event loop, with one FIFO per priority class.
+ *
+ * A task pushed with kMainTaskAfterQueued still overtakes the tasks queued after it, but first
+ * lets the older tasks of every class run, so a UI task scheduled before a state change cannot
+ * repaint stale content over it.
+ *
+ * Tasks live in a slot array allocated once, linked into the FIFOs by index, so Push() and
+ * RunNext() do not allocate in steady state. If every slot is taken the array grows, which
+ * reallocates it under the mutex; this is a fallback, counted in the overflows stat. A task can carry a deadline relative to its scheduling time: it still
+ * runs when late, but the miss is counted for its class. RunNext() records the queue wait
+ * and the execution time of every task per class.
+ */
+class MainTaskQueue {
+public:
+    explicit MainTaskQueue(size_t capacity);
+    MainTaskQueue(const MainTaskQueue&) = delete;
+    MainTaskQueue& operator=(const MainTaskQueue&) = delete;
+
+    /* Can be called from any task, `deadline_ms` 0 means no deadline */
+    void Push(MainTask&& task, MainTaskPriority priority, uint32_t deadline_ms = 0,
+        MainTaskOrder order = kMainTaskOvertake);
+
+    /* Runs the first task of the highest non-empty class, or the oldest task queued before it if
+     * it was pushed with kMainTaskAfterQueued. Returns false if the queue is empty */
+    bool RunNext();
+
+    size_t Size();
+    MainTaskQueueStats GetStats();
+    const LatencyHistogram& GetWaitHistogram(MainTaskPriority priority) const { return wait_histograms_[priority]; }
+    const LatencyHistogram& GetExecutionHistogram(MainTaskPriority priority) const { return execution_histograms_[priority]; }
+
+private:
+    struct Slot {
+        MainTask task;
+        int64_t queued_us = 0;
+        int64_t deadline_us = 0;
+        uint32_t sequence = 0;
+        bool after_queued = false;
+        int next = -1;
+    };
+
+    std::mutex mutex_;
+    std::vector<Slot> slots_;
+    int free_head_ = -1;
+    int head_[kMainTaskPriorityCount];
+    int tail_[kMainTaskPriorityCount];
+    size_t size_ = 0;
+    uint32_t next_sequence_ = 0;
+    MainTaskQueueStats stats_;
+    LatencyHistogram wait_histograms_[kMainTaskPriorityCount];
+    LatencyHistogram execution_histograms_[kMainTaskPriorityCount];
+};
+
+#endif // MAIN_TASK_QUEUE_H
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cstring>
 #include <esp_pthread.h>
+#include <esp_timer.h>
 
 #include "application.h"
 #include "display.h"
@@ -16,8 +17,6 @@
 
 #define TAG "MCP"
 
-#define DEFAULT_TOOLCALL_STACK_SIZE 6144
-
 McpServer::McpServer() {
 }
 
@@ -103,6 +102,31 @@ void McpServer::AddCommonTools() {
             });
     }
 
+    AddTool("self.diagnostics.audio_latency",
+        "Report the latency histograms of the audio pipeline, per stage, for diagnosing mouth-to-ear delay.\n"
+        "Uplink stages: capture_to_processed, encode_queue_wait, encode, send_queue_wait, capture_to_send.\n"
+        "Downlink stages: decode_queue_wait, decode, playback_queue_wait, i2s_write, receive_to_playback.\n"
+        "Args:\n"
+        "  `reset`: Clear the histograms after reading them.",
+        PropertyList({
+            Property("reset", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& audio_service = Application::GetInstance().GetAudioService();
+            auto json = audio_service.GetLatencyJson();
+            if (properties["reset"].value<bool>()) {
+                audio_service.ResetLatencyHistograms();
+            }
+            return json;
+        });
+
+    AddTool("self.diagnostics.tool_calls",
+        "Report per tool how often it was called, failed, rejected or cancelled, and its queue wait and run time.",
+        PropertyList(),
+        [this](const PropertyList& properties) -> ReturnValue {
+            return GetToolCallStatsJson();
+        });
+
     // Restore the original tools list to the end of the tools list
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
 }
@@ -123,9 +147,13 @@ void McpServer::AddTool(const std::string& name, const std::string& description,
 }
 
 void McpServer::ParseMessage(const std::string& message) {
-    cJSON* json = cJSON_Parse(message.c_str());
+    ParseMessage(message.data(), message.size());
+}
+
+void McpServer::ParseMessage(const char* data, size_t length) {
+    cJSON* json = cJSON_ParseWithLength(data, length);
     if (json == nullptr) {
-        ESP_LOGE(TAG, "Failed to parse MCP message: %s", message.c_str());
+        ESP_LOGE(TAG, "Failed to parse MCP message: %.*s", (int)length, data);
         return;
     }
     ParseMessage(json);
@@ -230,7 +258,7 @@ void McpServer::ParseMessage(const cJSON* json) {
             ReplyError(id_int, "Invalid stackSize");
             return;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, stack_size ? stack_size->valueint : DEFAULT_TOOLCALL_STACK_SIZE);
+        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, stack_size ? stack_size->valueint : MCP_TOOLCALL_STACK_SIZE);
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
         ReplyError(id_int, "Method not implemented: " + method_str);
@@ -347,21 +375,137 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
         return;
     }
 
-    // Start a task to receive data with stack size
-    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-    cfg.thread_name = "tool_call";
-    cfg.stack_size = stack_size;
-    cfg.prio = 1;
-    esp_pthread_set_cfg(&cfg);
-
-    // Use a thread to call the tool to avoid blocking the main thread
-    tool_call_thread_ = std::thread([this, id, tool_iter, arguments = std::move(arguments)]() {
-        try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
-        } catch (const std::exception& e) {
-            ESP_LOGE(TAG, "tools/call: %s", e.what());
-            ReplyError(id, e.what());
+    if (stack_size > MCP_TOOLCALL_LARGE_STACK_SIZE) {
+        // Larger than any worker, run it on a thread of its own as before the pool existed
+        ESP_LOGW(TAG, "tools/call: Stack size %d is larger than %d, using a dedicated thread", stack_size, MCP_TOOLCALL_LARGE_STACK_SIZE);
+        uint32_t generation;
+        {
+            std::lock_guard<std::mutex> lock(tool_call_mutex_);
+            generation = tool_call_generation_;
+        }
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.thread_name = "tool_call_huge";
+        cfg.stack_size = stack_size;
+        cfg.prio = 1;
+        esp_pthread_set_cfg(&cfg);
+        std::thread([this, call = ToolCall{id, *tool_iter, std::move(arguments), esp_timer_get_time(), generation}]() mutable {
+            RunToolCall(call, 0);
+        }).detach();
+        return;
+    }
+
+    // Queue the call for a worker of its stack size class to avoid blocking the main thread
+    auto& queue = tool_call_queues_[stack_size > MCP_TOOLCALL_STACK_SIZE ? 1 : 0];
+    std::unique_lock<std::mutex> lock(tool_call_mutex_);
+    if (queue.calls.size() >= MCP_TOOLCALL_QUEUE_SIZE) {
+        tool_call_stats_[*tool_iter].rejected++;
+        lock.unlock();
+        ESP_LOGE(TAG, "tools/call: Queue %s is full, rejecting %s", queue.name, tool_name.c_str());
+        ReplyError(id, "Too many tool calls in progress");
+        return;
+    }
+    queue.calls.push_back(ToolCall{id, *tool_iter, std::move(arguments), esp_timer_get_time(), tool_call_generation_});
+
+    // The workers are created at the first call of their class and live as long as the server
+    if (!queue.started) {
+        queue.started = true;
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.thread_name = queue.name;
+        cfg.stack_size = queue.stack_size;
+        cfg.prio = 1;
+        esp_pthread_set_cfg(&cfg);
+        for (int i = 0; i < queue.workers; i++) {
+            std::thread([this, &queue]() {
+                ToolCallWorker(&queue);
+            }).detach();
         }
-    });
-    tool_call_thread_.detach();
+    }
+    queue.condition.notify_one();
+}
+
+void McpServer::ToolCallWorker(ToolCallQueue* queue) {
+    while (true) {
+        std::unique_lock<std::mutex> lock(tool_call_mutex_);
+        queue->condition.wait(lock, [queue]() { return !queue->calls.empty(); });
+        auto call = std::move(queue->calls.front());
+        queue->calls.pop_front();
+        lock.unlock();
+
+        RunToolCall(call, esp_timer_get_time() - call.queued_us);
+    }
+}
+
+void McpServer::RunToolCall(ToolCall& call, uint32_t wait_us) {
+    int64_t start_time = esp_timer_get_time();
+    std::string result;
+    std::string error;
+    try {
+        result = call.tool->Call(call.arguments);
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "tools/call: %s", e.what());
+        error = e.what();
+    }
+    uint32_t run_us = esp_timer_get_time() - start_time;
+    ESP_LOGD(TAG, "tools/call: %s waited %lu ms, ran %lu ms", call.tool->name().c_str(), wait_us / 1000, run_us / 1000);
+
+    bool cancelled;
+    {
+        std::lock_guard<std::mutex> lock(tool_call_mutex_);
+        auto& stats = tool_call_stats_[call.tool];
+        cancelled = call.generation != tool_call_generation_;
+        stats.calls++;
+        stats.failures += error.empty() ? 0 : 1;
+        stats.cancelled += cancelled ? 1 : 0;
+        stats.total_wait_us += wait_us;
+        stats.total_run_us += run_us;
+        stats.max_wait_us = std::max(stats.max_wait_us, wait_us);
+        stats.max_run_us = std::max(stats.max_run_us, run_us);
+    }
+
+    // The session that asked for it is gone
+    if (cancelled) {
+        ESP_LOGW(TAG, "tools/call: Discard the result of %s", call.tool->name().c_str());
+        return;
+    }
+    if (error.empty()) {
+        ReplyResult(call.id, result);
+    } else {
+        ReplyError(call.id, error);
+    }
+}
+
+void McpServer::CancelToolCalls() {
+    std::lock_guard<std::mutex> lock(tool_call_mutex_);
+    tool_call_generation_++;
+    for (auto& queue : tool_call_queues_) {
+        for (auto& call : queue.calls) {
+            tool_call_stats_[call.tool].cancelled++;
+        }
+        if (!queue.calls.empty()) {
+            ESP_LOGW(TAG, "Cancel %u queued tool calls of %s", queue.calls.size(), queue.name);
+        }
+        queue.calls.clear();
+    }
+}
+
+std::string McpServer::GetToolCallStatsJson() {
+    std::lock_guard<std::mutex> lock(tool_call_mutex_);
+    cJSON* root = cJSON_CreateObject();
+    for (auto& [tool, stats] : tool_call_stats_) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "calls", stats.calls);
+        cJSON_AddNumberToObject(item, "failures", stats.failures);
+        cJSON_AddNumberToObject(item, "rejected", stats.rejected);
+        cJSON_AddNumberToObject(item, "cancelled", stats.cancelled);
+        cJSON_AddNumberToObject(item, "avg_wait_ms", stats.calls ? stats.total_wait_us / stats.calls / 1000 : 0);
+        cJSON_AddNumberToObject(item, "max_wait_ms", stats.max_wait_us / 1000);
+        cJSON_AddNumberToObject(item, "avg_run_ms", stats.calls ? stats.total_run_us / stats.calls / 1000 : 0);
+        cJSON_AddNumberToObject(item, "max_run_ms", stats.max_run_us / 1000);
+        cJSON_AddItemToObject(root, tool->name().c_str(), item);
+    }
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
 }
\ No newline at end of file
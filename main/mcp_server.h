@@ -9,6 +9,9 @@
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 #include <cJSON.h>
 
@@ -249,6 +252,25 @@ public:
     }
 };
 
+// Tool calls are run by a fixed set of workers per stack size class, each class has a bounded queue.
+// A call asking for more stack than the large class gets a thread of its own
+#define MCP_TOOLCALL_STACK_SIZE 6144
+#define MCP_TOOLCALL_WORKERS 2
+#define MCP_TOOLCALL_LARGE_STACK_SIZE 16384
+#define MCP_TOOLCALL_LARGE_WORKERS 1
+#define MCP_TOOLCALL_QUEUE_SIZE 8
+
+struct McpToolCallStats {
+    uint32_t calls = 0;
+    uint32_t failures = 0;      // The tool threw an exception
+    uint32_t rejected = 0;      // The queue of its stack size class was full
+    uint32_t cancelled = 0;     // Dropped from the queue or its result discarded when the audio channel closed
+    uint64_t total_wait_us = 0;
+    uint64_t total_run_us = 0;
+    uint32_t max_wait_us = 0;
+    uint32_t max_run_us = 0;
+};
+
 class McpServer {
 public:
     static McpServer& GetInstance() {
@@ -261,6 +283,11 @@ public:
     void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    void ParseMessage(const char* data, size_t length);
+    /* Drops the queued tool calls and discards the results of the running ones */
+    void CancelToolCalls();
+    /* Per tool call counts, queue wait and run time as JSON */
+    std::string GetToolCallStatsJson();
 
 private:
     McpServer();
@@ -274,8 +301,34 @@ private:
     void GetToolsList(int id, const std::string& cursor);
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, int stack_size);
 
+    struct ToolCall {
+        int id;
+        McpTool* tool;
+        PropertyList arguments;
+        int64_t queued_us;
+        uint32_t generation;
+    };
+    struct ToolCallQueue {
+        const char* name;
+        int stack_size;
+        int workers;
+        bool started = false;
+        std::deque<ToolCall> calls;
+        std::condition_variable condition;
+    };
+
     std::vector<McpTool*> tools_;
-    std::thread tool_call_thread_;
+    std::mutex tool_call_mutex_;
+    ToolCallQueue tool_call_queues_[2] = {
+        {"tool_call", MCP_TOOLCALL_STACK_SIZE, MCP_TOOLCALL_WORKERS},
+        {"tool_call_large", MCP_TOOLCALL_LARGE_STACK_SIZE, MCP_TOOLCALL_LARGE_WORKERS},
+    };
+    // Bumped by CancelToolCalls(), results of calls queued before are not sent
+    uint32_t tool_call_generation_ = 0;
+    std::map<const McpTool*, McpToolCallStats> tool_call_stats_;
+
+    void ToolCallWorker(ToolCallQueue* queue);
+    void RunToolCall(ToolCall& call, uint32_t wait_us);
 };
 
 #endif // MCP_SERVER_H
@@ -0,0 +1,68 @@
+#include "audio_packet_cipher.h"
+
+#include <esp_log.h>
+#include <arpa/inet.h>
+#include <cstring>
+
+#define TAG "AudioPacketCipher"
+
+AudioPacketCipher::AudioPacketCipher() {
+    mbedtls_aes_init(&aes_ctx_);
+}
+
+AudioPacketCipher::~AudioPacketCipher() {
+    mbedtls_aes_free(&aes_ctx_);
+}
+
+bool AudioPacketCipher::SetKey(const std::string& key, const std::string& nonce) {
+    has_key_ = false;
+    if (key.size() != 16 || nonce.size() != AUDIO_PACKET_HEADER_SIZE) {
+        ESP_LOGE(TAG, "Invalid key size: %u, nonce size: %u", key.size(), nonce.size());
+        return false;
+    }
+    mbedtls_aes_free(&aes_ctx_);
+    mbedtls_aes_init(&aes_ctx_);
+    if (mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)key.data(), 128) != 0) {
+        ESP_LOGE(TAG, "Failed to set AES key");
+        return false;
+    }
+    memcpy(nonce_, nonce.data(), sizeof(nonce_));
+    has_key_ = true;
+    return true;
+}
+
+bool AudioPacketCipher::Encrypt(const AudioStreamPacket& packet, uint32_t sequence, std::string& datagram) {
+    if (!has_key_) {
+        return false;
+    }
+    size_t payload_size = packet.payload.size();
+    datagram.resize(AUDIO_PACKET_HEADER_SIZE + payload_size);
+    auto header = (uint8_t*)datagram.data();
+    memcpy(header, nonce_, sizeof(nonce_));
+    *(uint16_t*)&header[2] = htons(payload_size);
+    *(uint32_t*)&header[8] = htonl(packet.timestamp);
+    *(uint32_t*)&header[12] = htonl(sequence);
+
+    // mbedtls advances the counter, so it works on a copy of the header
+    uint8_t counter[AUDIO_PACKET_HEADER_SIZE];
+    uint8_t stream_block[16];
+    size_t nc_off = 0;
+    memcpy(counter, header, sizeof(counter));
+    return mbedtls_aes_crypt_ctr(&aes_ctx_, payload_size, &nc_off, counter, stream_block,
+        packet.payload.data(), header + AUDIO_PACKET_HEADER_SIZE) == 0;
+}
+
+bool AudioPacketCipher::Decrypt(const uint8_t* datagram, size_t size, std::vector<uint8_t>& payload) {
+    if (!has_key_ || size < AUDIO_PACKET_HEADER_SIZE) {
+        return false;
+    }
+    size_t payload_size = size - AUDIO_PACKET_HEADER_SIZE;
+    payload.resize(payload_size);
+
+    uint8_t counter[AUDIO_PACKET_HEADER_SIZE];
+    uint8_t stream_block[16];
+    size_t nc_off = 0;
+    memcpy(counter, datagram, sizeof(counter));
+    return mbedtls_aes_crypt_ctr(&aes_ctx_, payload_size, &nc_off, counter, stream_block,
+        datagram + AUDIO_PACKET_HEADER_SIZE, payload.data()) == 0;
+}
@@ -0,0 +1,47 @@
+#ifndef AUDIO_PACKET_CIPHER_H
+#define AUDIO_PACKET_CIPHER_H
+
+#include <mbedtls/aes.h>
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+#define AUDIO_PACKET_HEADER_SIZE 16
+
+/*
+ * AES-128-CTR sealing of the MQTT+UDP audio datagrams:
+ * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|payload payload_len|
+ *
+ * The 16-byte header is the server nonce with payload_len, timestamp and sequence filled in,
+ * and it doubles as the initial CTR counter. The key schedule is expanded once per channel;
+ * the counter and stream block live on the stack and the output buffers keep their capacity,
+ * so sealing or opening a datagram does not allocate. With CONFIG_MBEDTLS_HARDWARE_AES (the
+ * IDF default) mbedtls runs the blocks on the AES peripheral.
+ */
+class AudioPacketCipher {
+public:
+    AudioPacketCipher();
+    ~AudioPacketCipher();
+    AudioPacketCipher(const AudioPacketCipher&) = delete;
+    AudioPacketCipher& operator=(const AudioPacketCipher&) = delete;
+
+    /* `key` and `nonce` are the raw 16-byte values from the server hello */
+    bool SetKey(const std::string& key, const std::string& nonce);
+
+    /* Replaces the contents of `datagram` with the header and the encrypted payload */
+    bool Encrypt(const AudioStreamPacket& packet, uint32_t sequence, std::string& datagram);
+
+    /* Replaces the contents of `payload` with the decrypted payload of `datagram` */
+    bool Decrypt(const uint8_t* datagram, size_t size, std::vector<uint8_t>& payload);
+
+private:
+    mbedtls_aes_context aes_ctx_;
+    uint8_t nonce_[AUDIO_PACKET_HEADER_SIZE] = {0};
+    bool has_key_ = false;
+};
+
+#endif // AUDIO_PACKET_CIPHER_H
@@ -0,0 +1,78 @@
+#include "control_message.h"
+
+#include <cstring>
+
+size_t EncodeControlMessage(const ControlMessage& message, uint8_t* buffer, size_t size) {
+    size_t text_length = message.text.IsString() ? message.text.length() : 0;
+    // Escaped text comes from JSON, the Send* helpers always pass plain text
+    if (message.type == kControlNone || message.text.escaped() || CONTROL_MESSAGE_HEADER_SIZE + text_length > size) {
+        return 0;
+    }
+    buffer[0] = message.type;
+    buffer[1] = message.state;
+    buffer[2] = message.param;
+    if (text_length > 0) {
+        memcpy(buffer + CONTROL_MESSAGE_HEADER_SIZE, message.text.data(), text_length);
+    }
+    return CONTROL_MESSAGE_HEADER_SIZE + text_length;
+}
+
+bool DecodeControlMessage(const uint8_t* data, size_t size, ControlMessage& message) {
+    if (size < CONTROL_MESSAGE_HEADER_SIZE || data[0] == kControlNone || data[0] > kControlLlm) {
+        return false;
+    }
+    message.type = (ControlMessageType)data[0];
+    message.state = data[1];
+    message.param = data[2];
+    message.text = JsonValue(kJsonString, (const char*)data + CONTROL_MESSAGE_HEADER_SIZE, size - CONTROL_MESSAGE_HEADER_SIZE);
+    return true;
+}
+
+bool ParseControlMessage(const JsonReader& root, ControlMessage& message) {
+    auto type = root.Get("type");
+    auto state = root.Get("state");
+    message = ControlMessage();
+    if (type.Equals("tts")) {
+        message.type = kControlTts;
+        if (state.Equals("start")) {
+            message.state = kControlTtsStart;
+        } else if (state.Equals("stop")) {
+            message.state = kControlTtsStop;
+        } else if (state.Equals("sentence_start")) {
+            message.state = kControlTtsSentenceStart;
+        } else if (state.Equals("sentence_end")) {
+            message.state = kControlTtsSentenceEnd;
+        } else {
+            return false;
+        }
+        message.text = root.Get("text");
+    } else if (type.Equals("stt")) {
+        message.type = kControlStt;
+        message.text = root.Get("text");
+    } else if (type.Equals("llm")) {
+        message.type = kControlLlm;
+        message.text = root.Get("emotion");
+    } else if (type.Equals("listen")) {
+        message.type = kControlListen;
+        if (state.Equals("start")) {
+            message.state = kControlListenStart;
+        } else if (state.Equals("stop")) {
+            message.state = kControlListenStop;
+        } else if (state.Equals("detect")) {
+            message.state = kControlListenDetect;
+        } else {
+            return false;
+        }
+        auto mode = root.Get("mode");
+        // Same values as ListeningMode
+        message.param = mode.Equals("realtime") ? 2 : mode.Equals("manual") ? 1 : 0;
+        message.text = root.Get("text");
+    } else if (type.Equals("abort")) {
+        message.type = kControlAbort;
+        // Same values as AbortReason
+        message.param = root.Get("reason").Equals("wake_word_detected") ? 1 : 0;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "json_reader.h"
+
+// Type of a BinaryProtocol2/3 frame that carries a control message instead of Opus (0) or JSON (1)
+#define BINARY_PROTOCOL_TYPE_CONTROL 2
+// type, state and param
+#define CONTROL_MESSAGE_HEADER_SIZE 3
+
+/*
+ * Compact binary form of the frequent control messages, used in place of the JSON text when
+ * both sides announce "binary_control" in the hello features.
+ *
+ * Payload layout: uint8 type, uint8 state, uint8 param, then the UTF-8 text up to the end of
+ * the frame (not NUL-terminated). The session is implied by the connection.
+ */
+enum ControlMessageType : uint8_t {
+    kControlNone = 0,
+    kControlListen = 1,     // state: ControlListenState, param: ListeningMode, text: wake word
+    kControlAbort = 2,      // param: AbortReason
+    kControlTts = 3,        // state: ControlTtsState, text: sentence
+    kControlStt = 4,        // text: recognized speech
+    kControlLlm = 5,        // text: emotion
+};
+
+enum ControlListenState : uint8_t {
+    kControlListenStart = 0,
+    kControlListenStop = 1,
+    kControlListenDetect = 2,
+};
+
+enum ControlTtsState : uint8_t {
+    kControlTtsStart = 0,
+    kControlTtsStop = 1,
+    kControlTtsSentenceStart = 2,
+    kControlTtsSentenceEnd = 3,
+};
+
+struct ControlMessage {
+    ControlMessageType type = kControlNone;
+    uint8_t state = 0;
+    uint8_t param = 0;
+    // Points into the received frame or JSON text, or the caller's string when sending
+    JsonValue text;
+};
+
+/* Writes `message` to `buffer`, returns the size, or 0 if it does not fit or the text is escaped */
+size_t EncodeControlMessage(const ControlMessage& message, uint8_t* buffer, size_t size);
+
+/* Reads a control message payload, the text points into `data` */
+bool DecodeControlMessage(const uint8_t* data, size_t size, ControlMessage& message);
+
+/* Maps the JSON form of tts / stt / llm / listen / abort messages, false for any other type */
+bool ParseControlMessage(const JsonReader& root, ControlMessage& message);
+
+#endif // CONTROL_MESSAGE_H
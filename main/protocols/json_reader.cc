@@ -0,0 +1,363 @@
+#include "json_reader.h"
+
+#include <cstring>
+
+// Deepest nesting of skipped objects and arrays, one bit per level
+#define JSON_READER_MAX_DEPTH 32
+
+static const char* SkipWhitespace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static int HexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool ReadHex4(const char* p, const char* end, uint32_t& value) {
+    if (end - p < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = HexValue(p[i]);
+        if (digit < 0) {
+            return false;
+        }
+        value = (value << 4) | digit;
+    }
+    return true;
+}
+
+/* Decodes one character of an escaped string into up to 4 UTF-8 bytes, returns 0 on bad input */
+static size_t DecodeChar(const char*& p, const char* end, char out[4]) {
+    if (*p != '\\') {
+        out[0] = *p++;
+        return 1;
+    }
+    if (end - p < 2) {
+        return 0;
+    }
+    char c = p[1];
+    p += 2;
+    switch (c) {
+    case '"': case '\\': case '/': out[0] = c; return 1;
+    case 'b': out[0] = '\b'; return 1;
+    case 'f': out[0] = '\f'; return 1;
+    case 'n': out[0] = '\n'; return 1;
+    case 'r': out[0] = '\r'; return 1;
+    case 't': out[0] = '\t'; return 1;
+    case 'u': break;
+    default: return 0;
+    }
+
+    uint32_t code;
+    if (!ReadHex4(p, end, code)) {
+        return 0;
+    }
+    p += 4;
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        uint32_t low;
+        if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !ReadHex4(p + 2, end, low) || low < 0xDC00 || low > 0xDFFF) {
+            return 0;
+        }
+        p += 6;
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+
+    if (code < 0x80) {
+        out[0] = code;
+        return 1;
+    } else if (code < 0x800) {
+        out[0] = 0xC0 | (code >> 6);
+        out[1] = 0x80 | (code & 0x3F);
+        return 2;
+    } else if (code < 0x10000) {
+        out[0] = 0xE0 | (code >> 12);
+        out[1] = 0x80 | ((code >> 6) & 0x3F);
+        out[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (code >> 18);
+    out[1] = 0x80 | ((code >> 12) & 0x3F);
+    out[2] = 0x80 | ((code >> 6) & 0x3F);
+    out[3] = 0x80 | (code & 0x3F);
+    return 4;
+}
+
+/* Reads the string starting at the opening quote at `p`, leaves `p` after the closing quote */
+static bool ReadString(const char*& p, const char* end, JsonValue& value) {
+    const char* start = ++p;
+    bool escaped = false;
+    while (p < end && *p != '"') {
+        if ((unsigned char)*p < 0x20) {
+            return false;
+        }
+        if (*p == '\\') {
+            escaped = true;
+            p++;
+        }
+        p++;
+    }
+    if (p >= end) {
+        return false;
+    }
+    value = JsonValue(kJsonString, start, p - start, escaped);
+    p++;
+    return true;
+}
+
+static bool ReadLiteral(const char*& p, const char* end, const char* literal, JsonType type, JsonValue& value) {
+    size_t length = strlen(literal);
+    if ((size_t)(end - p) < length || memcmp(p, literal, length) != 0) {
+        return false;
+    }
+    value = JsonValue(type, p, length);
+    p += length;
+    return true;
+}
+
+static bool ReadNumber(const char*& p, const char* end, JsonValue& value) {
+    const char* start = p;
+    if (p < end && *p == '-') {
+        p++;
+    }
+    const char* digits = p;
+    while (p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) {
+        p++;
+    }
+    if (p == digits || *digits < '0' || *digits > '9') {
+        return false;
+    }
+    value = JsonValue(kJsonNumber, start, p - start);
+    return true;
+}
+
+/* Skips over a nested object or array, checking that the brackets pair up */
+static bool SkipContainer(const char*& p, const char* end, JsonValue& value) {
+    const char* start = p;
+    uint32_t arrays = 0;    // Bit n is set if nesting level n is an array
+    int depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            JsonValue ignored;
+            if (!ReadString(p, end, ignored)) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            if (depth == JSON_READER_MAX_DEPTH) {
+                return false;
+            }
+            if (c == '[') {
+                arrays |= 1u << depth;
+            } else {
+                arrays &= ~(1u << depth);
+            }
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0 || ((arrays >> (depth - 1)) & 1) != (c == ']' ? 1u : 0u)) {
+                return false;
+            }
+            depth--;
+            if (depth == 0) {
+                p++;
+                value = JsonValue(*start == '{' ? kJsonObject : kJsonArray, start, p - start);
+                return true;
+            }
+        }
+        p++;
+    }
+    return false;
+}
+
+static bool ReadValue(const char*& p, const char* end, JsonValue& value) {
+    if (p >= end) {
+        return false;
+    }
+    switch (*p) {
+    case '"': return ReadString(p, end, value);
+    case '{': case '[': return SkipContainer(p, end, value);
+    case 't': return ReadLiteral(p, end, "true", kJsonBool, value);
+    case 'f': return ReadLiteral(p, end, "false", kJsonBool, value);
+    case 'n': return ReadLiteral(p, end, "null", kJsonNull, value);
+    default: return ReadNumber(p, end, value);
+    }
+}
+
+bool JsonValue::Equals(const char* text) const {
+    if (type_ != kJsonString) {
+        return false;
+    }
+    if (!escaped_) {
+        return strlen(text) == length_ && memcmp(data_, text, length_) == 0;
+    }
+    const char* p = data_;
+    const char* end = data_ + length_;
+    char decoded[4];
+    while (p < end) {
+        size_t count = DecodeChar(p, end, decoded);
+        if (count == 0) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++, text++) {
+            if (*text == '\0' || *text != decoded[i]) {
+                return false;
+            }
+        }
+    }
+    return *text == '\0';
+}
+
+bool JsonValue::AsBool(bool fallback) const {
+    return type_ == kJsonBool ? data_[0] == 't' : fallback;
+}
+
+int JsonValue::AsInt(int fallback) const {
+    if (type_ != kJsonNumber) {
+        return fallback;
+    }
+    const char* p = data_;
+    const char* end = data_ + length_;
+    bool negative = *p == '-';
+    if (negative) {
+        p++;
+    }
+    int64_t result = 0;
+    while (p < end && *p >= '0' && *p <= '9' && result <= INT32_MAX) {
+        result = result * 10 + (*p++ - '0');
+    }
+    if (result > INT32_MAX) {
+        return negative ? INT32_MIN : INT32_MAX;
+    }
+    return negative ? -result : result;
+}
+
+size_t JsonValue::CopyTo(char* buffer, size_t size) const {
+    if (size == 0) {
+        return 0;
+    }
+    size_t length = 0;
+    if (type_ != kJsonString || !escaped_) {
+        length = length_ < size - 1 ? length_ : size - 1;
+        // Do not cut a UTF-8 sequence in half
+        while (length < length_ && length > 0 && (data_[length] & 0xC0) == 0x80) {
+            length--;
+        }
+        memcpy(buffer, data_, length);
+    } else {
+        const char* p = data_;
+        const char* end = data_ + length_;
+        char decoded[4];
+        while (p < end) {
+            size_t count = DecodeChar(p, end, decoded);
+            if (count == 0 || length + count > size - 1) {
+                break;
+            }
+            memcpy(buffer + length, decoded, count);
+            length += count;
+        }
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+std::string JsonValue::ToString() const {
+    if (type_ != kJsonString || !escaped_) {
+        return std::string(data_ != nullptr ? data_ : "", length_);
+    }
+    std::string result;
+    result.reserve(length_);
+    const char* p = data_;
+    const char* end = data_ + length_;
+    char decoded[4];
+    while (p < end) {
+        size_t count = DecodeChar(p, end, decoded);
+        if (count == 0) {
+            break;
+        }
+        result.append(decoded, count);
+    }
+    return result;
+}
+
+JsonReader::JsonReader(const char* data, size_t length) : begin_(data), end_(data + length) {
+    Rewind();
+}
+
+JsonReader::JsonReader(const JsonValue& object) : begin_(object.data()), end_(object.data() + object.length()) {
+    Rewind();
+    if (!object.IsObject()) {
+        error_ = true;
+    }
+}
+
+void JsonReader::Rewind() {
+    first_ = true;
+    error_ = false;
+    cursor_ = SkipWhitespace(begin_, end_);
+    if (cursor_ < end_ && *cursor_ == '{') {
+        cursor_++;
+    } else {
+        error_ = true;
+    }
+}
+
+bool JsonReader::Next(JsonValue& key, JsonValue& value) {
+    if (error_) {
+        return false;
+    }
+    const char* p = SkipWhitespace(cursor_, end_);
+    if (p < end_ && *p == '}') {
+        cursor_ = p;
+        return false;
+    }
+    if (!first_) {
+        if (p >= end_ || *p != ',') {
+            error_ = true;
+            return false;
+        }
+        p = SkipWhitespace(p + 1, end_);
+    }
+    if (p >= end_ || *p != '"' || !ReadString(p, end_, key)) {
+        error_ = true;
+        return false;
+    }
+    p = SkipWhitespace(p, end_);
+    if (p >= end_ || *p != ':') {
+        error_ = true;
+        return false;
+    }
+    p = SkipWhitespace(p + 1, end_);
+    if (!ReadValue(p, end_, value)) {
+        error_ = true;
+        return false;
+    }
+    first_ = false;
+    cursor_ = p;
+    return true;
+}
+
+JsonValue JsonReader::Get(const char* key) const {
+    JsonReader reader = *this;
+    reader.Rewind();
+    JsonValue name;
+    JsonValue value;
+    while (reader.Next(name, value)) {
+        if (name.Equals(key)) {
+            return value;
+        }
+    }
+    return JsonValue();
+}
@@ -0,0 +1,90 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+enum JsonType {
+    kJsonInvalid,   // Missing member or malformed text
+    kJsonNull,
+    kJsonBool,
+    kJsonNumber,
+    kJsonString,
+    kJsonObject,
+    kJsonArray,
+};
+
+/*
+ * A value inside a JSON text, pointing into the caller's buffer.
+ *
+ * For strings data() is the text between the quotes, still escaped. Equals(), CopyTo() and
+ * ToString() decode the escapes on the fly. For every other type data() is the raw value text,
+ * so an object can be handed on as is (e.g. to cJSON) without being serialized again.
+ */
+class JsonValue {
+public:
+    JsonValue() = default;
+    JsonValue(JsonType type, const char* data, size_t length, bool escaped = false)
+        : type_(type), data_(data), length_(length), escaped_(escaped) {}
+
+    JsonType type() const { return type_; }
+    const char* data() const { return data_; }
+    size_t length() const { return length_; }
+    /* A string with escape sequences, data() is not its decoded text */
+    bool escaped() const { return escaped_; }
+
+    bool IsValid() const { return type_ != kJsonInvalid; }
+    bool IsNull() const { return type_ == kJsonNull; }
+    bool IsBool() const { return type_ == kJsonBool; }
+    bool IsNumber() const { return type_ == kJsonNumber; }
+    bool IsString() const { return type_ == kJsonString; }
+    bool IsObject() const { return type_ == kJsonObject; }
+    bool IsArray() const { return type_ == kJsonArray; }
+
+    /* True if this is a string equal to `text` */
+    bool Equals(const char* text) const;
+    bool AsBool(bool fallback = false) const;
+    /* Integer part of a number, `fallback` for any other type */
+    int AsInt(int fallback = 0) const;
+    /* Decodes a string into `buffer`, truncated and always NUL-terminated, returns the length */
+    size_t CopyTo(char* buffer, size_t size) const;
+    /* Decoded string, or the raw text of any other value */
+    std::string ToString() const;
+
+private:
+    JsonType type_ = kJsonInvalid;
+    const char* data_ = nullptr;
+    size_t length_ = 0;
+    bool escaped_ = false;
+};
+
+/*
+ * Pull-style reader for the members of a JSON object, it never allocates.
+ *
+ * Next() walks the members in order and Get() looks one up by key. Nested objects and arrays
+ * are only checked for balanced brackets while they are skipped over, a JsonReader built on
+ * such a value reads them in turn. The text does not need to be NUL-terminated.
+ */
+class JsonReader {
+public:
+    JsonReader(const char* data, size_t length);
+    explicit JsonReader(const JsonValue& object);
+
+    /* Next member of the object, false at its end or on malformed text (see error()) */
+    bool Next(JsonValue& key, JsonValue& value);
+    void Rewind();
+    bool error() const { return error_; }
+
+    /* First member named `key`, an invalid value if there is none */
+    JsonValue Get(const char* key) const;
+
+private:
+    const char* begin_;
+    const char* end_;
+    const char* cursor_ = nullptr;
+    bool error_ = false;
+    bool first_ = true;
+};
+
+#endif // JSON_READER_H
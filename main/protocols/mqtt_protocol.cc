@@ -4,6 +4,7 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <cstring>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
@@ -55,24 +56,27 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
-            ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
-            return;
-        }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
+        // Dispatch on the message type without building a cJSON tree
+        JsonReader root(payload.data(), payload.size());
+        auto type = root.Get("type");
+        if (!type.IsString()) {
             ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
             return;
         }
 
-        if (strcmp(type->valuestring, "hello") == 0) {
-            ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
-            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
-            if (session_id == nullptr || session_id_ == session_id->valuestring) {
+        if (type.Equals("hello")) {
+            // Once per session, the nested udp and audio params are read with cJSON
+            cJSON* hello = cJSON_ParseWithLength(payload.data(), payload.size());
+            if (hello == nullptr) {
+                ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
+                return;
+            }
+            ParseServerHello(hello);
+            cJSON_Delete(hello);
+        } else if (type.Equals("goodbye")) {
+            auto session_id = root.Get("session_id");
+            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id.IsString() ? session_id.ToString().c_str() : "null");
+            if (!session_id.IsString() || session_id.Equals(session_id_.c_str())) {
                 Application::GetInstance().Schedule([this]() {
                     CloseAudioChannel();
                     // 通知goodbye事件
@@ -82,7 +86,6 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         } else if (on_incoming_json_ != nullptr) {
             on_incoming_json_(root);
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -118,30 +121,38 @@ bool MqttProtocol::SendText(const std::string& text) {
     return true;
 }
 
-bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+bool MqttProtocol::SendAudio(const AudioStreamPacket& packet) {
     std::lock_guard<std::mutex> lock(channel_mutex_);
     if (udp_ == nullptr) {
         return false;
     }
+    return SendUdpAudio(packet);
+}
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet->payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
-
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
+size_t MqttProtocol::SendAudioBatch(const std::vector<std::unique_ptr<AudioStreamPacket>>& packets) {
+    // Every packet carries its own nonce and sequence, so a batch is still one datagram per packet,
+    // sent back to back under a single lock
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    if (udp_ == nullptr) {
+        return 0;
+    }
+    size_t sent = 0;
+    for (auto& packet : packets) {
+        if (!SendUdpAudio(*packet)) {
+            break;
+        }
+        sent++;
+    }
+    return sent;
+}
 
-    size_t nc_off = 0;
-    uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+// Called with channel_mutex_ held
+bool MqttProtocol::SendUdpAudio(const AudioStreamPacket& packet) {
+    if (!cipher_.Encrypt(packet, ++local_sequence_, udp_send_buffer_)) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
-
-    return udp_->Send(encrypted) > 0;
+    return udp_->Send(udp_send_buffer_) > 0;
 }
 
 void MqttProtocol::CloseAudioChannel() {
@@ -195,7 +206,7 @@ bool MqttProtocol::OpenAudioChannel() {
          * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
          * |payload payload_len|
          */
-        if (data.size() < sizeof(aes_nonce_)) {
+        if (data.size() < AUDIO_PACKET_HEADER_SIZE) {
             ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
             return;
         }
@@ -205,34 +216,35 @@ bool MqttProtocol::OpenAudioChannel() {
         }
         uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
         uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
+        last_incoming_time_ = std::chrono::steady_clock::now();
+
+        auto packet = AllocatePacket();
+        packet->timestamp = timestamp;
+        packet->sequence = sequence;
+        if (!cipher_.Decrypt((const uint8_t*)data.data(), data.size(), packet->payload)) {
+            ESP_LOGE(TAG, "Failed to decrypt audio data");
+            ReleasePacket(std::move(packet));
             return;
         }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
 
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
-        auto packet = std::make_unique<AudioStreamPacket>();
-        packet->sample_rate = server_sample_rate_;
-        packet->frame_duration = server_frame_duration_;
-        packet->timestamp = timestamp;
-        packet->payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        // Only packets that decrypted may move the window and its statistics
+        bool accepted;
+        {
+            // A server that leaves the timestamp at 0 gets its jitter measured against the sequence clock
+            uint32_t media_time_ms = timestamp != 0 ? timestamp : sequence * server_frame_duration_;
+            std::lock_guard<std::mutex> lock(receive_mutex_);
+            accepted = receive_window_.Accept(sequence, media_time_ms, esp_timer_get_time());
+        }
+        if (!accepted) {
+            ESP_LOGD(TAG, "Dropped late or duplicated audio packet: %lu", sequence);
+            ReleasePacket(std::move(packet));
             return;
         }
         if (on_incoming_audio_ != nullptr) {
             on_incoming_audio_(std::move(packet));
+        } else {
+            ReleasePacket(std::move(packet));
         }
-        remote_sequence_ = sequence;
-        last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
     udp_->Connect(udp_server_, udp_port_);
@@ -260,6 +272,7 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    AddUplinkAudioParams(audio_params);
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -293,6 +306,7 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
             server_frame_duration_ = frame_duration->valueint;
         }
     }
+    ParseUplinkAudioParams(audio_params);
 
     auto udp = cJSON_GetObjectItem(root, "udp");
     if (!cJSON_IsObject(udp)) {
@@ -306,11 +320,13 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
 
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
-    aes_nonce_ = DecodeHexString(nonce);
-    mbedtls_aes_init(&aes_ctx_);
-    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
+    cipher_.SetKey(DecodeHexString(key), DecodeHexString(nonce));
     local_sequence_ = 0;
-    remote_sequence_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(receive_mutex_);
+        receive_window_.Reset();
+    }
+    last_report_time_ = std::chrono::steady_clock::now();
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
@@ -333,6 +349,48 @@ std::string MqttProtocol::DecodeHexString(const std::string& hex_string) {
     return decoded;
 }
 
+AudioLinkStats MqttProtocol::GetAudioLinkStats() {
+    AudioLinkStats stats;
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    auto window = receive_window_.stats();
+    stats.received = window.received;
+    stats.lost = window.lost;
+    stats.jitter_us = window.jitter_us;
+    return stats;
+}
+
+void MqttProtocol::SendAudioLinkReport() {
+#if CONFIG_MQTT_UDP_STATS_REPORT_INTERVAL > 0
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_report_time_ < std::chrono::seconds(CONFIG_MQTT_UDP_STATS_REPORT_INTERVAL)) {
+        return;
+    }
+    last_report_time_ = now;
+
+    UdpReceiveStats stats;
+    {
+        std::lock_guard<std::mutex> lock(receive_mutex_);
+        stats = receive_window_.TakeIntervalStats();
+    }
+    if (stats.expected == 0) {
+        return;
+    }
+    // Receiver report of the downlink, so the server can adapt its TTS bitrate
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"udp_stats\"";
+    message += ",\"received\":" + std::to_string(stats.received);
+    message += ",\"expected\":" + std::to_string(stats.expected);
+    message += ",\"lost\":" + std::to_string(stats.lost);
+    message += ",\"fraction_lost\":" + std::to_string(stats.fraction_lost);
+    message += ",\"reordered\":" + std::to_string(stats.reordered);
+    message += ",\"duplicated\":" + std::to_string(stats.duplicated);
+    message += ",\"late\":" + std::to_string(stats.late);
+    message += ",\"highest_sequence\":" + std::to_string(stats.highest_sequence);
+    message += ",\"jitter_ms\":" + std::to_string(stats.jitter_us / 1000);
+    message += "}";
+    SendText(message);
+#endif
+}
+
 bool MqttProtocol::IsAudioChannelOpened() const {
     return udp_ != nullptr && !error_occurred_ && !IsTimeout();
 }
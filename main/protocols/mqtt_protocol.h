@@ -3,10 +3,11 @@
 
 
 #include "protocol.h"
+#include "audio_packet_cipher.h"
+#include "udp_receive_window.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
-#include <mbedtls/aes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
@@ -26,10 +27,13 @@ public:
     ~MqttProtocol();
 
     bool Start() override;
-    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudio(const AudioStreamPacket& packet) override;
+    size_t SendAudioBatch(const std::vector<std::unique_ptr<AudioStreamPacket>>& packets) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    AudioLinkStats GetAudioLinkStats() override;
+    void SendAudioLinkReport() override;
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -39,18 +43,21 @@ private:
     std::mutex channel_mutex_;
     std::unique_ptr<Mqtt> mqtt_;
     std::unique_ptr<Udp> udp_;
-    mbedtls_aes_context aes_ctx_;
-    std::string aes_nonce_;
+    AudioPacketCipher cipher_;
+    std::string udp_send_buffer_;
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
+    std::mutex receive_mutex_;
+    UdpReceiveWindow receive_window_{CONFIG_MQTT_UDP_REORDER_WINDOW};
+    std::chrono::time_point<std::chrono::steady_clock> last_report_time_;
 
     bool StartMqttClient(bool report_error=false);
     void ParseServerHello(const cJSON* root);
     std::string DecodeHexString(const std::string& hex_string);
 
     bool SendText(const std::string& text) override;
+    bool SendUdpAudio(const AudioStreamPacket& packet);
     std::string GetHelloMessage();
 };
 
@@ -4,14 +4,38 @@
 
 #define TAG "Protocol"
 
-void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
+void Protocol::OnIncomingJson(std::function<void(const JsonReader& root)> callback) {
     on_incoming_json_ = callback;
 }
 
+void Protocol::OnIncomingControl(std::function<void(const ControlMessage& message)> callback) {
+    on_incoming_control_ = callback;
+}
+
 void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
     on_incoming_audio_ = callback;
 }
 
+void Protocol::SetPacketAllocator(std::function<std::unique_ptr<AudioStreamPacket>()> allocator,
+    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> releaser) {
+    packet_allocator_ = allocator;
+    packet_releaser_ = releaser;
+}
+
+std::unique_ptr<AudioStreamPacket> Protocol::AllocatePacket() {
+    // Pooled packets keep their payload capacity, so filling one does not allocate
+    auto packet = packet_allocator_ ? packet_allocator_() : std::make_unique<AudioStreamPacket>();
+    packet->sample_rate = server_sample_rate_;
+    packet->frame_duration = server_frame_duration_;
+    return packet;
+}
+
+void Protocol::ReleasePacket(std::unique_ptr<AudioStreamPacket> packet) {
+    if (packet_releaser_) {
+        packet_releaser_(std::move(packet));
+    }
+}
+
 void Protocol::OnAudioChannelOpened(std::function<void()> callback) {
     on_audio_channel_opened_ = callback;
 }
@@ -31,7 +55,24 @@ void Protocol::SetError(const std::string& message) {
     }
 }
 
+size_t Protocol::SendAudioBatch(const std::vector<std::unique_ptr<AudioStreamPacket>>& packets) {
+    size_t sent = 0;
+    for (auto& packet : packets) {
+        if (!SendAudio(*packet)) {
+            break;
+        }
+        sent++;
+    }
+    return sent;
+}
+
 void Protocol::SendAbortSpeaking(AbortReason reason) {
+    ControlMessage control;
+    control.type = kControlAbort;
+    control.param = reason;
+    if (SendControl(control)) {
+        return;
+    }
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
     if (reason == kAbortReasonWakeWordDetected) {
         message += ",\"reason\":\"wake_word_detected\"";
@@ -41,12 +82,26 @@ void Protocol::SendAbortSpeaking(AbortReason reason) {
 }
 
 void Protocol::SendWakeWordDetected(const std::string& wake_word) {
+    ControlMessage control;
+    control.type = kControlListen;
+    control.state = kControlListenDetect;
+    control.text = JsonValue(kJsonString, wake_word.data(), wake_word.size());
+    if (SendControl(control)) {
+        return;
+    }
     std::string json = "{\"session_id\":\"" + session_id_ + 
                       "\",\"type\":\"listen\",\"state\":\"detect\",\"text\":\"" + wake_word + "\"}";
     SendText(json);
 }
 
 void Protocol::SendStartListening(ListeningMode mode) {
+    ControlMessage control;
+    control.type = kControlListen;
+    control.state = kControlListenStart;
+    control.param = mode;
+    if (SendControl(control)) {
+        return;
+    }
     std::string message = "{\"session_id\":\"" + session_id_ + "\"";
     message += ",\"type\":\"listen\",\"state\":\"start\"";
     if (mode == kListeningModeRealtime) {
@@ -61,6 +116,12 @@ void Protocol::SendStartListening(ListeningMode mode) {
 }
 
 void Protocol::SendStopListening() {
+    ControlMessage control;
+    control.type = kControlListen;
+    control.state = kControlListenStop;
+    if (SendControl(control)) {
+        return;
+    }
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"listen\",\"state\":\"stop\"}";
     SendText(message);
 }
@@ -70,6 +131,46 @@ void Protocol::SendMcpMessage(const std::string& payload) {
     SendText(message);
 }
 
+void Protocol::AddUplinkAudioParams(cJSON* audio_params) {
+    // Uplink options the device supports, the server picks in its hello
+    cJSON* uplink = cJSON_CreateObject();
+    cJSON* frame_durations = cJSON_CreateArray();
+    for (int duration : {20, 40, 60}) {
+        cJSON_AddItemToArray(frame_durations, cJSON_CreateNumber(duration));
+    }
+    cJSON_AddItemToObject(uplink, "frame_durations", frame_durations);
+    cJSON_AddBoolToObject(uplink, "dtx", true);
+    cJSON_AddBoolToObject(uplink, "adaptive", true);
+    cJSON_AddItemToObject(audio_params, "uplink", uplink);
+}
+
+void Protocol::ParseUplinkAudioParams(const cJSON* audio_params) {
+    uplink_audio_params_ = UplinkAudioParams();
+    auto uplink = cJSON_GetObjectItem(audio_params, "uplink");
+    if (!cJSON_IsObject(uplink)) {
+        return;
+    }
+    auto frame_duration = cJSON_GetObjectItem(uplink, "frame_duration");
+    if (cJSON_IsNumber(frame_duration)) {
+        int duration = frame_duration->valueint;
+        if (duration == 20 || duration == 40 || duration == 60) {
+            uplink_audio_params_.frame_duration = duration;
+        } else {
+            ESP_LOGW(TAG, "Unsupported uplink frame duration: %d", duration);
+        }
+    }
+    auto dtx = cJSON_GetObjectItem(uplink, "dtx");
+    if (cJSON_IsBool(dtx)) {
+        uplink_audio_params_.dtx = cJSON_IsTrue(dtx);
+    }
+    auto adaptive = cJSON_GetObjectItem(uplink, "adaptive");
+    if (cJSON_IsBool(adaptive)) {
+        uplink_audio_params_.adaptive = cJSON_IsTrue(adaptive);
+    }
+    ESP_LOGI(TAG, "Uplink audio: %d ms frames, dtx %d, adaptive %d", uplink_audio_params_.frame_duration,
+        uplink_audio_params_.dtx, uplink_audio_params_.adaptive);
+}
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
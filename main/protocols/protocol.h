@@ -4,14 +4,35 @@
 #include <cJSON.h>
 #include <string>
 #include <functional>
+#include <memory>
 #include <chrono>
 #include <vector>
 
+#include "json_reader.h"
+#include "control_message.h"
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // Transport sequence number, 0 if the transport has none
     std::vector<uint8_t> payload;
+    // Local latency tracing (esp_timer_get_time), 0 if unknown
+    int64_t origin_time_us = 0;  // Uplink: PCM capture, downlink: network receive
+    int64_t stage_time_us = 0;   // When the packet entered its current queue
+};
+
+/* Uplink Opus settings negotiated in the hello audio_params */
+struct UplinkAudioParams {
+    int frame_duration = 60;    // Preferred frame duration in ms: 20, 40 or 60
+    bool dtx = false;
+    bool adaptive = false;      // Lengthen frames on loss or send backlog, shorten them again when healthy
+};
+
+struct AudioLinkStats {
+    uint32_t received = 0;      // Incoming audio packets since the audio channel was opened
+    uint32_t lost = 0;          // Sequence numbers that never arrived
+    uint32_t jitter_us = 0;     // RFC 3550 interarrival jitter
 };
 
 struct BinaryProtocol2 {
@@ -54,9 +75,17 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    inline const UplinkAudioParams& uplink_audio_params() const {
+        return uplink_audio_params_;
+    }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
-    void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    /* Packets come from `allocator`, those dropped before reaching OnIncomingAudio go back to `releaser` */
+    void SetPacketAllocator(std::function<std::unique_ptr<AudioStreamPacket>()> allocator,
+        std::function<void(std::unique_ptr<AudioStreamPacket> packet)> releaser);
+    void OnIncomingJson(std::function<void(const JsonReader& root)> callback);
+    /* Binary control messages, the JSON fallback of the same messages goes to OnIncomingJson */
+    void OnIncomingControl(std::function<void(const ControlMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -64,30 +93,50 @@ public:
     virtual bool Start() = 0;
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel() = 0;
+    /* Optionally connect ahead of OpenAudioChannel() while idle, and drop that connection
+       once it outlives its budget (or right away when `force` is set) */
+    virtual void WarmUpAudioChannel() {}
+    virtual void CoolDownAudioChannel(bool force) {}
     virtual bool IsAudioChannelOpened() const = 0;
-    virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    /* Whether MCP messages share the audio channel and cannot be sent once it is closed */
+    virtual bool IsMcpOnAudioChannel() const { return false; }
+    virtual bool SendAudio(const AudioStreamPacket& packet) = 0;
+    /* Sends the packets in order, returns how many were sent before the first failure */
+    virtual size_t SendAudioBatch(const std::vector<std::unique_ptr<AudioStreamPacket>>& packets);
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    virtual AudioLinkStats GetAudioLinkStats() { return AudioLinkStats(); }
+    virtual void SendAudioLinkReport() {}
 
 protected:
-    std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const JsonReader& root)> on_incoming_json_;
+    std::function<void(const ControlMessage& message)> on_incoming_control_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
+    std::function<std::unique_ptr<AudioStreamPacket>()> packet_allocator_;
+    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> packet_releaser_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
     std::function<void(const std::string& message)> on_network_error_;
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    UplinkAudioParams uplink_audio_params_;
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual bool SendText(const std::string& text) = 0;
+    /* Sends the binary form if the server negotiated it, false to fall back to JSON */
+    virtual bool SendControl(const ControlMessage& message) { return false; }
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
+    std::unique_ptr<AudioStreamPacket> AllocatePacket();
+    void ReleasePacket(std::unique_ptr<AudioStreamPacket> packet);
+    void AddUplinkAudioParams(cJSON* audio_params);
+    void ParseUplinkAudioParams(const cJSON* audio_params);
 };
 
 #endif // PROTOCOL_H
@@ -0,0 +1,97 @@
+#include "udp_receive_window.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// A single transit sample above this is a talkspurt gap or a clock step, not jitter
+#define MAX_JITTER_SAMPLE_US 1000000
+
+UdpReceiveWindow::UdpReceiveWindow(uint32_t reorder_window)
+    : reorder_window_(std::clamp<uint32_t>(reorder_window, 1, UDP_RECEIVE_MAX_WINDOW)) {
+}
+
+void UdpReceiveWindow::Reset() {
+    started_ = false;
+    base_sequence_ = 0;
+    highest_sequence_ = 0;
+    expected_before_restart_ = 0;
+    received_mask_ = 0;
+    has_transit_ = false;
+    last_transit_us_ = 0;
+    jitter_us_ = 0;
+    expected_prior_ = 0;
+    received_prior_ = 0;
+    stats_ = UdpReceiveStats();
+}
+
+void UdpReceiveWindow::Restart(uint32_t sequence) {
+    if (started_) {
+        expected_before_restart_ += highest_sequence_ - base_sequence_ + 1;
+    }
+    started_ = true;
+    base_sequence_ = sequence;
+    highest_sequence_ = sequence;
+    received_mask_ = 1;
+    has_transit_ = false;
+}
+
+bool UdpReceiveWindow::Accept(uint32_t sequence, uint32_t timestamp_ms, int64_t arrival_us) {
+    int32_t delta = static_cast<int32_t>(sequence - highest_sequence_);
+    if (!started_ || delta > UDP_RECEIVE_MAX_DROPOUT || delta < -UDP_RECEIVE_MAX_MISORDER) {
+        // First packet, or the sender restarted its sequence numbers
+        Restart(sequence);
+    } else if (delta > 0) {
+        received_mask_ = delta >= 64 ? 0 : received_mask_ << delta;
+        received_mask_ |= 1;
+        highest_sequence_ = sequence;
+    } else {
+        uint32_t age = -delta;
+        if (age >= reorder_window_) {
+            stats_.late++;
+            return false;
+        }
+        if (received_mask_ & (1ull << age)) {
+            stats_.duplicated++;
+            return false;
+        }
+        received_mask_ |= 1ull << age;
+        stats_.reordered++;
+    }
+
+    stats_.received++;
+    UpdateJitter(timestamp_ms, arrival_us);
+    return true;
+}
+
+void UdpReceiveWindow::UpdateJitter(uint32_t timestamp_ms, int64_t arrival_us) {
+    int64_t transit_us = arrival_us - (int64_t)timestamp_ms * 1000;
+    if (has_transit_) {
+        int64_t delta_us = std::min<int64_t>(std::abs(transit_us - last_transit_us_), MAX_JITTER_SAMPLE_US);
+        jitter_us_ = (int64_t)jitter_us_ + (delta_us - (int64_t)jitter_us_) / 16;
+    }
+    last_transit_us_ = transit_us;
+    has_transit_ = true;
+}
+
+UdpReceiveStats UdpReceiveWindow::stats() const {
+    UdpReceiveStats stats = stats_;
+    stats.expected = started_ ? expected_before_restart_ + highest_sequence_ - base_sequence_ + 1 : expected_before_restart_;
+    stats.lost = stats.expected > stats.received ? stats.expected - stats.received : 0;
+    stats.highest_sequence = highest_sequence_;
+    stats.jitter_us = jitter_us_;
+    return stats;
+}
+
+UdpReceiveStats UdpReceiveWindow::TakeIntervalStats() {
+    UdpReceiveStats stats = this->stats();
+    uint32_t expected_interval = stats.expected - expected_prior_;
+    uint32_t received_interval = stats.received - received_prior_;
+    expected_prior_ = stats.expected;
+    received_prior_ = stats.received;
+    stats.fraction_lost = 0;
+    if (expected_interval > received_interval) {
+        stats.fraction_lost = std::min<uint32_t>(((expected_interval - received_interval) << 8) / expected_interval, 255);
+    }
+    stats_.fraction_lost = stats.fraction_lost;
+    return stats;
+}
@@ -0,0 +1,59 @@
+#ifndef UDP_RECEIVE_WINDOW_H
+#define UDP_RECEIVE_WINDOW_H
+
+#include <cstdint>
+
+/* A sequence jump larger than this (or a step back larger than MAX_MISORDER) restarts the window */
+#define UDP_RECEIVE_MAX_DROPOUT 3000
+#define UDP_RECEIVE_MAX_MISORDER 100
+#define UDP_RECEIVE_MAX_WINDOW 64
+
+struct UdpReceiveStats {
+    uint32_t received = 0;          // Packets accepted
+    uint32_t expected = 0;          // Sequence numbers spanned since the channel was opened
+    uint32_t lost = 0;              // expected - received, never negative
+    uint32_t reordered = 0;         // Accepted after a higher sequence number
+    uint32_t duplicated = 0;
+    uint32_t late = 0;              // Older than the reorder window, dropped
+    uint32_t highest_sequence = 0;
+    uint32_t jitter_us = 0;         // RFC 3550 interarrival jitter
+    uint8_t fraction_lost = 0;      // RFC 3550 fraction lost (1/256) over the last report interval
+};
+
+/*
+ * Receive side bookkeeping of the MQTT+UDP audio channel, after RFC 3550 appendix A.
+ *
+ * Packets up to `reorder_window` sequence numbers behind the highest one are accepted and left
+ * for the jitter buffer to reorder; older packets and duplicates are rejected. Loss is counted
+ * from the sequence numbers spanned, so a late arrival takes back its loss, and the
+ * interarrival jitter uses the packet timestamp (ms) as the media clock. Not thread safe.
+ */
+class UdpReceiveWindow {
+public:
+    explicit UdpReceiveWindow(uint32_t reorder_window);
+
+    void Reset();
+    bool Accept(uint32_t sequence, uint32_t timestamp_ms, int64_t arrival_us);
+    UdpReceiveStats stats() const;
+    /* Same as stats(), with fraction_lost computed since the previous call */
+    UdpReceiveStats TakeIntervalStats();
+
+private:
+    uint32_t reorder_window_;
+    bool started_ = false;
+    uint32_t base_sequence_ = 0;
+    uint32_t highest_sequence_ = 0;
+    uint32_t expected_before_restart_ = 0;
+    uint64_t received_mask_ = 0;    // Bit n: highest_sequence_ - n was received
+    bool has_transit_ = false;
+    int64_t last_transit_us_ = 0;
+    uint32_t jitter_us_ = 0;
+    uint32_t expected_prior_ = 0;
+    uint32_t received_prior_ = 0;
+    UdpReceiveStats stats_;
+
+    void Restart(uint32_t sequence);
+    void UpdateJitter(uint32_t timestamp_ms, int64_t arrival_us);
+};
+
+#endif // UDP_RECEIVE_WINDOW_H
@@ -7,6 +7,7 @@
 #include <cstring>
 #include <cJSON.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -17,44 +18,89 @@ WebsocketProtocol::WebsocketProtocol() {
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
+    // The warm up task uses this object until it finishes
+    bool warming;
+    {
+        std::lock_guard<std::mutex> lock(warm_mutex_);
+        warm_cancelled_ = true;
+        warming = warming_;
+    }
+    if (warming) {
+        xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_WARM_UP_DONE_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+    }
     vEventGroupDelete(event_group_handle_);
 }
 
 bool WebsocketProtocol::Start() {
+    // Read once here, Connect also runs on the warm up task
+    Settings settings("websocket", false);
+    int version = settings.GetInt("version");
+    if (version != 0) {
+        version_ = version;
+    }
     // Only connect to server when audio channel is needed
     return true;
 }
 
-bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
 
+    if (version_ != 2 && version_ != 3) {
+        return websocket_->Send(packet.payload.data(), packet.payload.size(), true);
+    }
+
+    // The header and payload go out as one frame, built in a buffer that keeps its capacity between packets
+    size_t header_size = version_ == 2 ? sizeof(BinaryProtocol2) : sizeof(BinaryProtocol3);
+    send_buffer_.resize(header_size + packet.payload.size());
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
+        auto bp2 = (BinaryProtocol2*)send_buffer_.data();
         bp2->version = htons(version_);
         bp2->type = 0;
         bp2->reserved = 0;
-        bp2->timestamp = htonl(packet->timestamp);
-        bp2->payload_size = htonl(packet->payload.size());
-        memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
-
-        return websocket_->Send(serialized.data(), serialized.size(), true);
-    } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
+        bp2->timestamp = htonl(packet.timestamp);
+        bp2->payload_size = htonl(packet.payload.size());
+    } else {
+        auto bp3 = (BinaryProtocol3*)send_buffer_.data();
         bp3->type = 0;
         bp3->reserved = 0;
-        bp3->payload_size = htons(packet->payload.size());
-        memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
+        bp3->payload_size = htons(packet.payload.size());
+    }
+    memcpy(send_buffer_.data() + header_size, packet.payload.data(), packet.payload.size());
+    return websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
+}
+
+bool WebsocketProtocol::SendControl(const ControlMessage& message) {
+    if (!binary_control_ || websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+    size_t header_size = version_ == 2 ? sizeof(BinaryProtocol2) : sizeof(BinaryProtocol3);
+    send_buffer_.resize(header_size + CONTROL_MESSAGE_HEADER_SIZE + message.text.length());
+    size_t payload_size = EncodeControlMessage(message, send_buffer_.data() + header_size, send_buffer_.size() - header_size);
+    if (payload_size == 0 || payload_size > UINT16_MAX) {
+        return false;
+    }
+    if (version_ == 2) {
+        auto bp2 = (BinaryProtocol2*)send_buffer_.data();
+        bp2->version = htons(version_);
+        bp2->type = htons(BINARY_PROTOCOL_TYPE_CONTROL);
+        bp2->reserved = 0;
+        bp2->timestamp = 0;
+        bp2->payload_size = htonl(payload_size);
     } else {
-        return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
+        auto bp3 = (BinaryProtocol3*)send_buffer_.data();
+        bp3->type = BINARY_PROTOCOL_TYPE_CONTROL;
+        bp3->reserved = 0;
+        bp3->payload_size = htons(payload_size);
     }
+    if (!websocket_->Send(send_buffer_.data(), header_size + payload_size, true)) {
+        ESP_LOGE(TAG, "Failed to send control message: %u", message.type);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    return true;
 }
 
 bool WebsocketProtocol::SendText(const std::string& text) {
@@ -72,29 +118,159 @@ bool WebsocketProtocol::SendText(const std::string& text) {
 }
 
 bool WebsocketProtocol::IsAudioChannelOpened() const {
-    return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
+    return websocket_ != nullptr && websocket_->IsConnected() && session_started_ && !error_occurred_ && !IsTimeout();
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
+    // Cleared first, so the disconnect callback of the reset below does not report the close again
+    bool was_open = session_started_.exchange(false);
     websocket_.reset();
+    if (was_open && on_audio_channel_closed_ != nullptr) {
+        on_audio_channel_closed_();
+    }
+}
+
+bool WebsocketProtocol::IsAudioChannelWarm() const {
+    return websocket_ != nullptr && websocket_->IsConnected() && !session_started_;
+}
+
+void WebsocketProtocol::WarmUpAudioChannel() {
+#if CONFIG_WEBSOCKET_KEEP_WARM_SECONDS > 0
+    if (websocket_ != nullptr && websocket_->IsConnected()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(warm_mutex_);
+        if (warming_ || warm_websocket_ != nullptr) {
+            return;
+        }
+        warming_ = true;
+        warm_cancelled_ = false;
+    }
+    xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_WARM_UP_DONE_EVENT);
+
+    // TCP, TLS and the websocket upgrade take seconds, so they run in their own task instead of
+    // the main loop. The hello is sent when the channel is opened.
+    BaseType_t created = xTaskCreate([](void* arg) {
+        auto protocol = (WebsocketProtocol*)arg;
+        protocol->WarmUpTask();
+        vTaskDelete(NULL);
+    }, "ws_warm_up", 2048 * 4, this, 1, nullptr);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the warm up task");
+        std::lock_guard<std::mutex> lock(warm_mutex_);
+        warming_ = false;
+        xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_WARM_UP_DONE_EVENT);
+    }
+#endif
+}
+
+void WebsocketProtocol::WarmUpTask() {
+    auto start_time = esp_timer_get_time();
+    auto websocket = Connect(false);
+
+    std::lock_guard<std::mutex> lock(warm_mutex_);
+    if (websocket != nullptr && !warm_cancelled_) {
+        warm_websocket_ = std::move(websocket);
+        ESP_LOGI(TAG, "Audio channel warmed up in %lld ms", (esp_timer_get_time() - start_time) / 1000);
+    }
+    warming_ = false;
+    xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_WARM_UP_DONE_EVENT);
+}
+
+void WebsocketProtocol::AdoptWarmChannel(bool wait) {
+    if (wait) {
+        bool warming;
+        {
+            std::lock_guard<std::mutex> lock(warm_mutex_);
+            warming = warming_;
+        }
+        if (warming) {
+            // The channel has to connect anyway, finishing the warm up is never slower
+            xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_WARM_UP_DONE_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+        }
+    }
+    std::lock_guard<std::mutex> lock(warm_mutex_);
+    if (warm_websocket_ == nullptr) {
+        return;
+    }
+    websocket_ = std::move(warm_websocket_);
+    error_occurred_ = false;
+    session_started_ = false;
+    binary_control_ = false;
+    warm_since_ = std::chrono::steady_clock::now();
+}
+
+void WebsocketProtocol::CoolDownAudioChannel(bool force) {
+#if CONFIG_WEBSOCKET_KEEP_WARM_SECONDS > 0
+    if (force) {
+        // A warm up still connecting is dropped when it finishes
+        std::lock_guard<std::mutex> lock(warm_mutex_);
+        warm_cancelled_ = true;
+        warm_websocket_.reset();
+    } else {
+        AdoptWarmChannel(false);
+    }
+    if (!IsAudioChannelWarm()) {
+        return;
+    }
+    if (force || std::chrono::steady_clock::now() - warm_since_ >= std::chrono::seconds(CONFIG_WEBSOCKET_KEEP_WARM_SECONDS)) {
+        ESP_LOGI(TAG, "Releasing the warm audio channel");
+        websocket_.reset();
+    }
+#endif
 }
 
 bool WebsocketProtocol::OpenAudioChannel() {
+#if CONFIG_WEBSOCKET_KEEP_WARM_SECONDS > 0
+    AdoptWarmChannel(true);
+#endif
+    if (IsAudioChannelWarm()) {
+        ESP_LOGI(TAG, "Opening the warm audio channel");
+        error_occurred_ = false;
+    } else {
+        error_occurred_ = false;
+        session_started_ = false;
+        binary_control_ = false;
+        websocket_ = Connect(true);
+        if (websocket_ == nullptr) {
+            return false;
+        }
+    }
+    last_incoming_time_ = std::chrono::steady_clock::now();
+
+    // Send hello message to describe the client
+    auto message = GetHelloMessage();
+    if (!SendText(message)) {
+        return false;
+    }
+
+    // Wait for server hello
+    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
+    if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
+        ESP_LOGE(TAG, "Failed to receive server hello");
+        SetError(Lang::Strings::SERVER_TIMEOUT);
+        return false;
+    }
+
+    session_started_ = true;
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+
+    return true;
+}
+
+std::unique_ptr<WebSocket> WebsocketProtocol::Connect(bool report_error) {
     Settings settings("websocket", false);
     std::string url = settings.GetString("url");
     std::string token = settings.GetString("token");
-    int version = settings.GetInt("version");
-    if (version != 0) {
-        version_ = version;
-    }
-
-    error_occurred_ = false;
 
     auto network = Board::GetInstance().GetNetwork();
-    websocket_ = network->CreateWebSocket(1);
-    if (websocket_ == nullptr) {
+    auto websocket = network->CreateWebSocket(1);
+    if (websocket == nullptr) {
         ESP_LOGE(TAG, "Failed to create websocket");
-        return false;
+        return nullptr;
     }
 
     if (!token.empty()) {
@@ -102,101 +278,84 @@ bool WebsocketProtocol::OpenAudioChannel() {
         if (token.find(" ") == std::string::npos) {
             token = "Bearer " + token;
         }
-        websocket_->SetHeader("Authorization", token.c_str());
+        websocket->SetHeader("Authorization", token.c_str());
     }
-    websocket_->SetHeader("Protocol-Version", std::to_string(version_).c_str());
-    websocket_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    websocket->SetHeader("Protocol-Version", std::to_string(version_).c_str());
+    websocket->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    websocket->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
 
-    websocket_->OnData([this](const char* data, size_t len, bool binary) {
+    websocket->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
-            if (on_incoming_audio_ != nullptr) {
-                if (version_ == 2) {
-                    BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
-                    bp2->version = ntohs(bp2->version);
-                    bp2->type = ntohs(bp2->type);
-                    bp2->timestamp = ntohl(bp2->timestamp);
-                    bp2->payload_size = ntohl(bp2->payload_size);
-                    auto payload = (uint8_t*)bp2->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = bp2->timestamp,
-                        .payload = std::vector<uint8_t>(payload, payload + bp2->payload_size)
-                    }));
-                } else if (version_ == 3) {
-                    BinaryProtocol3* bp3 = (BinaryProtocol3*)data;
-                    bp3->type = bp3->type;
-                    bp3->payload_size = ntohs(bp3->payload_size);
-                    auto payload = (uint8_t*)bp3->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
-                    }));
-                } else {
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>((uint8_t*)data, (uint8_t*)data + len)
-                    }));
+            // Parse the header in place, the payload is copied once into a pooled packet
+            size_t header_size = version_ == 2 ? sizeof(BinaryProtocol2) : version_ == 3 ? sizeof(BinaryProtocol3) : 0;
+            auto payload = (const uint8_t*)data + header_size;
+            size_t payload_size = len - header_size;
+            uint32_t timestamp = 0;
+            int type = 0;
+            if (version_ == 2 && len >= header_size) {
+                auto bp2 = (const BinaryProtocol2*)data;
+                type = ntohs(bp2->type);
+                timestamp = ntohl(bp2->timestamp);
+                payload_size = ntohl(bp2->payload_size);
+            } else if (version_ == 3 && len >= header_size) {
+                auto bp3 = (const BinaryProtocol3*)data;
+                type = bp3->type;
+                payload_size = ntohs(bp3->payload_size);
+            }
+            if (len < header_size || payload_size > len - header_size) {
+                ESP_LOGE(TAG, "Invalid binary frame, payload size: %u, frame size: %u", payload_size, len);
+            } else if (type == BINARY_PROTOCOL_TYPE_CONTROL) {
+                ControlMessage message;
+                if (!DecodeControlMessage(payload, payload_size, message)) {
+                    ESP_LOGE(TAG, "Invalid control message, type: %u, size: %u", payload_size > 0 ? payload[0] : 0, payload_size);
+                } else if (on_incoming_control_ != nullptr) {
+                    on_incoming_control_(message);
                 }
+            } else if (on_incoming_audio_ != nullptr) {
+                auto packet = AllocatePacket();
+                packet->timestamp = timestamp;
+                packet->payload.assign(payload, payload + payload_size);
+                on_incoming_audio_(std::move(packet));
             }
         } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "hello") == 0) {
-                    ParseServerHello(root);
-                } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
+            // Dispatch on the message type without building a cJSON tree
+            JsonReader root(data, len);
+            auto type = root.Get("type");
+            if (type.Equals("hello")) {
+                // Once per session, the nested audio params are read with cJSON
+                auto hello = cJSON_ParseWithLength(data, len);
+                if (hello != nullptr) {
+                    ParseServerHello(hello);
+                    cJSON_Delete(hello);
+                }
+            } else if (type.IsString()) {
+                if (on_incoming_json_ != nullptr) {
+                    on_incoming_json_(root);
                 }
             } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
+                ESP_LOGE(TAG, "Missing message type, data: %.*s", (int)len, data);
             }
-            cJSON_Delete(root);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
-    websocket_->OnDisconnected([this]() {
+    websocket->OnDisconnected([this]() {
         ESP_LOGI(TAG, "Websocket disconnected");
-        if (on_audio_channel_closed_ != nullptr) {
+        // A warm connection dropped by the server was never an open channel
+        if (session_started_.exchange(false) && on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
     });
 
     ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
-    if (!websocket_->Connect(url.c_str())) {
+    if (!websocket->Connect(url.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
-    }
-
-    // Send hello message to describe the client
-    auto message = GetHelloMessage();
-    if (!SendText(message)) {
-        return false;
-    }
-
-    // Wait for server hello
-    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
-    if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
-        ESP_LOGE(TAG, "Failed to receive server hello");
-        SetError(Lang::Strings::SERVER_TIMEOUT);
-        return false;
-    }
-
-    if (on_audio_channel_opened_ != nullptr) {
-        on_audio_channel_opened_();
+        if (report_error) {
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+        }
+        return nullptr;
     }
-
-    return true;
+    return websocket;
 }
 
 std::string WebsocketProtocol::GetHelloMessage() {
@@ -209,13 +368,24 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddBoolToObject(features, "aec", true);
 #endif
     cJSON_AddBoolToObject(features, "mcp", true);
+    if (version_ == 2 || version_ == 3) {
+        // Frequent control messages can travel as binary frames, see control_message.h
+        cJSON_AddBoolToObject(features, "binary_control", true);
+    }
     cJSON_AddItemToObject(root, "features", features);
     cJSON_AddStringToObject(root, "transport", "websocket");
+#if CONFIG_WEBSOCKET_KEEP_WARM_SECONDS > 0
+    // Lets the server resume the previous conversation on a new connection
+    if (!session_id_.empty()) {
+        cJSON_AddStringToObject(root, "session_id", session_id_.c_str());
+    }
+#endif
     cJSON* audio_params = cJSON_CreateObject();
     cJSON_AddStringToObject(audio_params, "format", "opus");
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    AddUplinkAudioParams(audio_params);
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -248,6 +418,12 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
             server_frame_duration_ = frame_duration->valueint;
         }
     }
+    ParseUplinkAudioParams(audio_params);
+
+    auto features = cJSON_GetObjectItem(root, "features");
+    auto binary_control = cJSON_GetObjectItem(features, "binary_control");
+    binary_control_ = (version_ == 2 || version_ == 3) && cJSON_IsTrue(binary_control);
+    ESP_LOGI(TAG, "Binary control messages: %s", binary_control_ ? "on" : "off");
 
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
 }
@@ -8,7 +8,11 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
+#include <atomic>
+#include <mutex>
+
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
+#define WEBSOCKET_PROTOCOL_WARM_UP_DONE_EVENT (1 << 1)
 
 class WebsocketProtocol : public Protocol {
 public:
@@ -16,18 +20,38 @@ public:
     ~WebsocketProtocol();
 
     bool Start() override;
-    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudio(const AudioStreamPacket& packet) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    bool IsMcpOnAudioChannel() const override { return true; }
+    void WarmUpAudioChannel() override;
+    void CoolDownAudioChannel(bool force) override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
-
+    // Hello exchanged, a connected websocket without it is a warm standby
+    std::atomic<bool> session_started_ = false;
+    // The server hello accepted the binary_control feature
+    std::atomic<bool> binary_control_ = false;
+    std::chrono::time_point<std::chrono::steady_clock> warm_since_;
+    std::vector<uint8_t> send_buffer_;
+    // Connected by the warm up task, moved to websocket_ on the main loop
+    std::mutex warm_mutex_;
+    std::unique_ptr<WebSocket> warm_websocket_;
+    bool warming_ = false;
+    bool warm_cancelled_ = false;
+
+    // Also runs on the warm up task, must not write members
+    std::unique_ptr<WebSocket> Connect(bool report_error);
+    bool IsAudioChannelWarm() const;
+    void WarmUpTask();
+    void AdoptWarmChannel(bool wait);
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
+    bool SendControl(const ControlMessage& message) override;
     std::string GetHelloMessage();
 };
 
@@ -0,0 +1,13 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+/*
+ * Number of operator new calls so far, on all threads. Linking alloc_counter.cc replaces the
+ * global operator new, so a benchmark can report allocations per frame like the heap hooks
+ * would on the device.
+ */
+uint64_t HostAllocationCount();
+
+#endif // ALLOC_COUNTER_H
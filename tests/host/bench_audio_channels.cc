@@ -0,0 +1,134 @@
+/*
+ * Cost per 60 ms stereo frame of the audio_channels kernels against the per-sample loops they
+ * replaced: the mic/reference split, the re-interleave after resampling, and the in-place
+ * mono extraction of NoAudioProcessor and the audio testing path.
+ *
+ * Built with -fno-tree-vectorize, like the Xtensa targets which do not auto-vectorize, so the
+ * plain loops stay plain. Cycles are the x86 time stamp counter and are only printed there.
+ *
+ * Usage: bench_audio_channels [frames] [sample_rate]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#endif
+
+#include "audio_channels.h"
+
+#define FRAME_DURATION_MS 60
+
+using Clock = std::chrono::steady_clock;
+
+__attribute__((noinline)) static void ScalarSplit(const int16_t* input, int16_t* left, int16_t* right, size_t frames) {
+    for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
+        left[i] = input[j];
+        right[i] = input[j + 1];
+    }
+}
+
+__attribute__((noinline)) static void ScalarMerge(const int16_t* left, const int16_t* right, int16_t* output, size_t frames) {
+    for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
+        output[j] = left[i];
+        output[j + 1] = right[i];
+    }
+}
+
+__attribute__((noinline)) static void ScalarExtract(int16_t* data, size_t frames) {
+    for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
+        data[i] = data[j];
+    }
+}
+
+struct Timing {
+    double ns = 0;
+    double cycles = 0;
+};
+
+template <typename Kernel>
+static Timing Measure(int frames, Kernel kernel) {
+    auto start = Clock::now();
+#if HAVE_CYCLE_COUNTER
+    uint64_t start_cycles = __rdtsc();
+#endif
+    for (int n = 0; n < frames; n++) {
+        kernel();
+    }
+    Timing timing;
+#if HAVE_CYCLE_COUNTER
+    timing.cycles = (double)(__rdtsc() - start_cycles) / frames;
+#endif
+    timing.ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() / frames;
+    return timing;
+}
+
+static void Report(const char* name, const Timing& scalar, const Timing& kernel) {
+    printf("%-10s %12.1f %12.1f", name, scalar.ns, kernel.ns);
+#if HAVE_CYCLE_COUNTER
+    printf(" %14.0f %14.0f", scalar.cycles, kernel.cycles);
+#endif
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 100000;
+    int sample_rate = argc > 2 ? atoi(argv[2]) : 16000;
+    if (frames <= 0 || sample_rate <= 0) {
+        fprintf(stderr, "usage: %s [frames] [sample_rate]\n", argv[0]);
+        return 1;
+    }
+    size_t samples = sample_rate * FRAME_DURATION_MS / 1000;
+
+    std::vector<int16_t> stereo(samples * 2);
+    for (size_t i = 0; i < stereo.size(); i++) {
+        stereo[i] = (int16_t)(i * 31);
+    }
+    std::vector<int16_t> left(samples), right(samples), left_ref(samples), right_ref(samples);
+    std::vector<int16_t> merged(samples * 2), merged_ref(samples * 2);
+    std::vector<int16_t> mono(samples * 2), mono_ref(samples * 2);
+
+    // Same output first, so the timings compare equivalent work
+    ScalarSplit(stereo.data(), left_ref.data(), right_ref.data(), samples);
+    SplitStereo(stereo.data(), left.data(), right.data(), samples);
+    ScalarMerge(left.data(), right.data(), merged_ref.data(), samples);
+    MergeStereo(left.data(), right.data(), merged.data(), samples);
+    mono_ref = stereo;
+    ScalarExtract(mono_ref.data(), samples);
+    mono = stereo;
+    ExtractChannel(mono.data(), mono.data(), samples, 2, 0);
+    mono.resize(samples);
+    mono_ref.resize(samples);
+    if (left != left_ref || right != right_ref || merged != merged_ref || merged != stereo || mono != mono_ref) {
+        fprintf(stderr, "The kernels and the per-sample loops disagree\n");
+        return 1;
+    }
+
+    printf("%d frames of %zu stereo samples (%d ms at %d Hz), per frame\n", frames, samples, FRAME_DURATION_MS, sample_rate);
+    printf("%-10s %12s %12s", "", "loop ns", "kernel ns");
+#if HAVE_CYCLE_COUNTER
+    printf(" %14s %14s", "loop cycles", "kernel cycles");
+#endif
+    printf("\n");
+
+    Report("split", Measure(frames, [&]() { ScalarSplit(stereo.data(), left.data(), right.data(), samples); }),
+        Measure(frames, [&]() { SplitStereo(stereo.data(), left.data(), right.data(), samples); }));
+    Report("merge", Measure(frames, [&]() { ScalarMerge(left.data(), right.data(), merged.data(), samples); }),
+        Measure(frames, [&]() { MergeStereo(left.data(), right.data(), merged.data(), samples); }));
+
+    // In place, the source is restored before every frame in both runs
+    mono.resize(samples * 2);
+    auto restore = [&]() { std::copy(stereo.begin(), stereo.end(), mono.begin()); };
+    auto copy_only = Measure(frames, restore);
+    auto extract_scalar = Measure(frames, [&]() { restore(); ScalarExtract(mono.data(), samples); });
+    auto extract_kernel = Measure(frames, [&]() { restore(); ExtractChannel(mono.data(), mono.data(), samples, 2, 0); });
+    extract_scalar.ns -= copy_only.ns;
+    extract_scalar.cycles -= copy_only.cycles;
+    extract_kernel.ns -= copy_only.ns;
+    extract_kernel.cycles -= copy_only.cycles;
+    Report("extract", extract_scalar, extract_kernel);
+    return 0;
+}
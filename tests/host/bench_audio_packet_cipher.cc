@@ -0,0 +1,126 @@
+/*
+ * Throughput of sealing and opening MQTT+UDP audio datagrams: AudioPacketCipher against the
+ * per-packet path it replaced in MqttProtocol, which copied the nonce into a new std::string,
+ * built the ciphertext in another one, and decrypted into a freshly allocated packet.
+ *
+ * AES runs on the OpenSSL shim here, not on the AES peripheral, so compare the two columns
+ * rather than the absolute rates with the device.
+ *
+ * Usage: bench_audio_packet_cipher [packets] [payload_bytes]
+ */
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "audio_packet_cipher.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    double packets_per_sec;
+    double allocations_per_packet;
+};
+
+template <typename Run>
+static Result Measure(int packets, Run run) {
+    uint64_t allocations = HostAllocationCount();
+    auto start = Clock::now();
+    for (int i = 0; i < packets; i++) {
+        if (!run(i)) {
+            fprintf(stderr, "Packet %d failed\n", i);
+            exit(1);
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    allocations = HostAllocationCount() - allocations;
+    return {elapsed > 0 ? packets * 1e9 / elapsed : 0, (double)allocations / packets};
+}
+
+int main(int argc, char** argv) {
+    int packets = argc > 1 ? atoi(argv[1]) : 200000;
+    int payload_size = argc > 2 ? atoi(argv[2]) : 120;
+    if (packets <= 0 || payload_size <= 0 || payload_size > UINT16_MAX) {
+        fprintf(stderr, "usage: %s [packets] [payload_bytes]\n", argv[0]);
+        return 1;
+    }
+
+    // Fixed key and server nonce, the datagram layout is the one MqttProtocol sends
+    std::string key("0123456789abcdef");
+    std::string nonce("\x01\x00\x00\x00\x5a\xa5\x5a\xa5\x00\x00\x00\x00\x00\x00\x00\x00", AUDIO_PACKET_HEADER_SIZE);
+    AudioStreamPacket packet;
+    packet.payload.resize(payload_size);
+    for (size_t i = 0; i < packet.payload.size(); i++) {
+        packet.payload[i] = i * 7;
+    }
+
+    // The previous implementation
+    mbedtls_aes_context legacy_ctx;
+    mbedtls_aes_init(&legacy_ctx);
+    mbedtls_aes_setkey_enc(&legacy_ctx, (const unsigned char*)key.data(), 128);
+    std::string legacy_datagram;
+    auto legacy_encrypt = Measure(packets, [&](int i) {
+        packet.timestamp = i * 60;
+        std::string packet_nonce(nonce);
+        *(uint16_t*)&packet_nonce[2] = htons(packet.payload.size());
+        *(uint32_t*)&packet_nonce[8] = htonl(packet.timestamp);
+        *(uint32_t*)&packet_nonce[12] = htonl(i + 1);
+        std::string encrypted;
+        encrypted.resize(packet_nonce.size() + packet.payload.size());
+        memcpy(encrypted.data(), packet_nonce.data(), packet_nonce.size());
+        size_t nc_off = 0;
+        uint8_t stream_block[16] = {0};
+        int ret = mbedtls_aes_crypt_ctr(&legacy_ctx, packet.payload.size(), &nc_off, (uint8_t*)packet_nonce.data(),
+            stream_block, packet.payload.data(), (uint8_t*)&encrypted[packet_nonce.size()]);
+        legacy_datagram.swap(encrypted);
+        return ret == 0;
+    });
+    std::unique_ptr<AudioStreamPacket> legacy_packet;
+    auto legacy_decrypt = Measure(packets, [&](int) {
+        auto incoming = std::make_unique<AudioStreamPacket>();
+        size_t decrypted_size = legacy_datagram.size() - nonce.size();
+        size_t nc_off = 0;
+        uint8_t stream_block[16] = {0};
+        uint8_t counter[AUDIO_PACKET_HEADER_SIZE];
+        memcpy(counter, legacy_datagram.data(), sizeof(counter));
+        incoming->payload.resize(decrypted_size);
+        int ret = mbedtls_aes_crypt_ctr(&legacy_ctx, decrypted_size, &nc_off, counter, stream_block,
+            (const uint8_t*)legacy_datagram.data() + nonce.size(), incoming->payload.data());
+        legacy_packet = std::move(incoming);
+        return ret == 0;
+    });
+    mbedtls_aes_free(&legacy_ctx);
+
+    AudioPacketCipher cipher;
+    cipher.SetKey(key, nonce);
+    std::string datagram;
+    datagram.reserve(AUDIO_PACKET_HEADER_SIZE + payload_size);
+    auto encrypt = Measure(packets, [&](int i) {
+        packet.timestamp = i * 60;
+        return cipher.Encrypt(packet, i + 1, datagram);
+    });
+    std::vector<uint8_t> decrypted;
+    decrypted.reserve(payload_size);
+    auto decrypt = Measure(packets, [&](int) {
+        return cipher.Decrypt((const uint8_t*)datagram.data(), datagram.size(), decrypted);
+    });
+
+    if (datagram != legacy_datagram || decrypted != packet.payload || legacy_packet->payload != packet.payload) {
+        fprintf(stderr, "AudioPacketCipher and the per-packet path disagree\n");
+        return 1;
+    }
+
+    printf("%d packets of %d payload bytes\n", packets, payload_size);
+    printf("%-8s %-18s %14s %16s\n", "", "path", "packets/sec", "allocs/packet");
+    printf("%-8s %-18s %14.0f %16.2f\n", "encrypt", "per-packet string", legacy_encrypt.packets_per_sec, legacy_encrypt.allocations_per_packet);
+    printf("%-8s %-18s %14.0f %16.2f\n", "encrypt", "AudioPacketCipher", encrypt.packets_per_sec, encrypt.allocations_per_packet);
+    printf("%-8s %-18s %14.0f %16.2f\n", "decrypt", "per-packet alloc", legacy_decrypt.packets_per_sec, legacy_decrypt.allocations_per_packet);
+    printf("%-8s %-18s %14.0f %16.2f\n", "decrypt", "AudioPacketCipher", decrypt.packets_per_sec, decrypt.allocations_per_packet);
+    return 0;
+}
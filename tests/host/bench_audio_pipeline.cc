@@ -0,0 +1,196 @@
+/*
+ * Runs the real AudioService on the host: NoAudioProcessor, the encode and decode tasks, the
+ * rings, frame pools and jitter buffer, with a WAV file (or a synthetic tone) as the microphone.
+ * The main thread plays the application main loop and the server at once: it drains the send
+ * queue and loops every packet back into the decode queue, and the decoded audio is collected
+ * as the speaker output.
+ *
+ * Reported per 60 ms frame, after a warm-up: wall time (frames/sec), process CPU time and heap
+ * allocations on all threads. Opus is a mu-law stand-in (see stubs/opus_encoder.h), so the
+ * numbers cover the pipeline around the codec, not the codec itself.
+ *
+ * Usage: bench_audio_pipeline [--seconds N] [--input in.wav] [--output out.wav]
+ *                             [--input-rate HZ] [--output-rate HZ] [--realtime]
+ */
+#include <time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "audio_service.h"
+#include "wav_audio_codec.h"
+
+#define FRAME_DURATION_MS OPUS_FRAME_DURATION_MS
+#define WARMUP_FRAMES 10
+#define STALL_TIMEOUT_MS 5000
+
+struct Snapshot {
+    int64_t wall_us;
+    int64_t cpu_us;
+    uint64_t allocations;
+};
+
+static Snapshot TakeSnapshot() {
+    timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    return {esp_timer_get_time(), cpu.tv_sec * 1000000LL + cpu.tv_nsec / 1000, HostAllocationCount()};
+}
+
+static std::vector<int16_t> MakeTone(int sample_rate, int seconds) {
+    // 440 Hz with a little pseudo random noise, the same every run
+    std::vector<int16_t> samples((size_t)sample_rate * seconds);
+    uint32_t noise = 12345;
+    for (size_t i = 0; i < samples.size(); i++) {
+        noise = noise * 1103515245 + 12345;
+        float tone = 8000.0f * sinf(2.0f * (float)M_PI * 440.0f * i / sample_rate);
+        samples[i] = (int16_t)(tone + (int)((noise >> 16) & 0x7ff) - 1024);
+    }
+    return samples;
+}
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s [--seconds N] [--input in.wav] [--output out.wav] [--input-rate HZ] "
+        "[--output-rate HZ] [--realtime]\n", name);
+}
+
+int main(int argc, char** argv) {
+    int seconds = 10;
+    int input_rate = 16000;
+    int output_rate = 24000;
+    bool realtime = false;
+    std::string input_path;
+    std::string output_path;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--seconds") == 0 && has_value) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--input") == 0 && has_value) {
+            input_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--input-rate") == 0 && has_value) {
+            input_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output-rate") == 0 && has_value) {
+            output_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<int16_t> input;
+    int input_channels = 1;
+    if (!input_path.empty()) {
+        if (!ReadWavFile(input_path, input, input_rate, input_channels)) {
+            fprintf(stderr, "Cannot read %s, only 16-bit PCM WAV is supported\n", input_path.c_str());
+            return 1;
+        }
+    } else {
+        input = MakeTone(input_rate, seconds);
+    }
+    if (seconds <= 0 || input_rate <= 0 || output_rate <= 0 || input_channels != 1) {
+        // NoAudioProcessor frames stereo input by its mono size, keep to mono here
+        Usage(argv[0]);
+        return 1;
+    }
+
+    // Whole frames only, the last partial one would never leave the encoder
+    size_t input_frame_samples = input_rate * FRAME_DURATION_MS / 1000;
+    int frames = input.size() / input_frame_samples;
+    input.resize(frames * input_frame_samples);
+    size_t output_frame_samples = output_rate * FRAME_DURATION_MS / 1000;
+    if (frames <= WARMUP_FRAMES) {
+        fprintf(stderr, "Need more than %d frames of input\n", WARMUP_FRAMES);
+        return 1;
+    }
+
+    WavAudioCodec codec(std::move(input), input_rate, input_channels, output_rate, realtime);
+    int status = 0;
+    {
+        AudioService audio_service;
+        audio_service.Initialize(&codec);
+        TaskHandle_t main_task = xTaskGetCurrentTaskHandle();
+        AudioServiceCallbacks callbacks;
+        callbacks.on_send_queue_available = [main_task]() {
+            xTaskNotifyGive(main_task);
+        };
+        audio_service.SetCallbacks(callbacks);
+        audio_service.Start();
+        audio_service.EnableVoiceProcessing(true);
+
+        Snapshot start = {};
+        bool measuring = false;
+        size_t played = 0;
+        int64_t last_progress_us = esp_timer_get_time();
+        while (played < (size_t)frames * output_frame_samples) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+            while (auto packet = audio_service.PopPacketFromSendQueue()) {
+                audio_service.RecordPacketSent(*packet);
+                packet->origin_time_us = esp_timer_get_time();
+                audio_service.PushPacketToDecodeQueue(std::move(packet), true);
+            }
+
+            size_t output_samples = codec.output_samples();
+            int64_t now = esp_timer_get_time();
+            if (output_samples != played) {
+                played = output_samples;
+                last_progress_us = now;
+            } else if (now - last_progress_us > STALL_TIMEOUT_MS * 1000) {
+                fprintf(stderr, "Stalled after %zu of %d frames\n", played / output_frame_samples, frames);
+                status = 1;
+                break;
+            }
+            if (!measuring && played >= WARMUP_FRAMES * output_frame_samples) {
+                start = TakeSnapshot();
+                measuring = true;
+            }
+        }
+        Snapshot end = TakeSnapshot();
+
+        audio_service.EnableVoiceProcessing(false);
+        audio_service.Stop();
+        codec.Close();
+        HostWaitForTasks();
+
+        int measured = played / output_frame_samples - WARMUP_FRAMES;
+        if (measuring && measured > 0) {
+            double wall_us = end.wall_us - start.wall_us;
+            printf("%d frames of %d ms, %d Hz in, %d Hz out%s, %d warm-up frames not measured\n", frames,
+                FRAME_DURATION_MS, input_rate, output_rate, realtime ? ", realtime" : "", WARMUP_FRAMES);
+            printf("frames/sec        %10.1f\n", measured * 1000000.0 / wall_us);
+            printf("realtime factor   %10.1f\n", measured * FRAME_DURATION_MS * 1000.0 / wall_us);
+            printf("cpu us/frame      %10.1f\n", (double)(end.cpu_us - start.cpu_us) / measured);
+            printf("allocs/frame      %10.2f\n", (double)(end.allocations - start.allocations) / measured);
+            auto tasks = audio_service.GetTaskPoolStats();
+            auto packets = audio_service.GetPacketPoolStats();
+            printf("task pool         %u misses, %u drops, high water %zu/%zu\n", tasks.misses, tasks.drops,
+                tasks.high_water, tasks.capacity);
+            printf("packet pool       %u misses, %u drops, high water %zu/%zu\n", packets.misses, packets.drops,
+                packets.high_water, packets.capacity);
+            printf("latency           %s\n", audio_service.GetLatencyJson().c_str());
+        }
+    }
+
+    // FNV-1a over the output, changes only if the audio path changes
+    uint32_t checksum = 2166136261u;
+    for (auto sample : codec.output()) {
+        checksum = (checksum ^ (uint16_t)sample) * 16777619u;
+    }
+    printf("output            %zu samples, checksum %08x\n", codec.output().size(), checksum);
+    if (!output_path.empty() && !WriteWavFile(output_path, codec.output(), output_rate, 1)) {
+        fprintf(stderr, "Cannot write %s\n", output_path.c_str());
+        status = 1;
+    }
+    if (codec.output().size() != (size_t)frames * output_frame_samples) {
+        fprintf(stderr, "Played %zu samples, expected %zu\n", codec.output().size(), (size_t)frames * output_frame_samples);
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,97 @@
+/*
+ * Decode time per frame of the emotion GIFs in main/assets/gif, with the gifdec calls GifPlayer
+ * makes on the LVGL task: gd_get_frame() followed by gd_render_frame() into the canvas.
+ *
+ * The changed rectangle of each frame is averaged as well, it is the share of the image that
+ * GifPlayer invalidates instead of the whole image.
+ *
+ * Usage: bench_gif_decode [frames_per_gif]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "lvgl.h"
+#include "libs/gif/gifdec.h"
+
+#define GIF_ASSETS(X) X(angry) X(confident) X(confused) X(crying) X(happy) X(kissy) X(laughing) \
+    X(loving) X(neutral) X(relaxed) X(sad) X(silly) X(sleepy) X(surprised) X(thinking) X(winking)
+
+#define DECLARE_ASSET(name) extern const lv_image_dsc_t name;
+extern "C" {
+GIF_ASSETS(DECLARE_ASSET)
+}
+
+struct GifAsset {
+    const char* name;
+    const lv_image_dsc_t* dsc;
+};
+
+#define LIST_ASSET(name) {#name, &name},
+static const GifAsset kAssets[] = {GIF_ASSETS(LIST_ASSET)};
+
+using Clock = std::chrono::steady_clock;
+
+static bool Bench(const GifAsset& asset, int frames) {
+    gd_GIF* gif = gd_open_gif_data(asset.dsc->data);
+    if (gif == nullptr) {
+        fprintf(stderr, "%s: failed to open\n", asset.name);
+        return false;
+    }
+
+    std::vector<double> samples;
+    samples.reserve(frames);
+    double changed = 0;
+    for (int i = 0; i < frames; i++) {
+        auto start = Clock::now();
+        int result = gd_get_frame(gif);
+        if (result < 0) {
+            fprintf(stderr, "%s: bad frame %d\n", asset.name, i);
+            gd_close_gif(gif);
+            return false;
+        }
+        if (result == 0) {
+            // Its loop count ran out, start over as SetSource() would
+            gd_rewind(gif);
+            gif->loop_count = 0;
+            i--;
+            continue;
+        }
+        gd_render_frame(gif, gif->canvas);
+        samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        changed += (double)gif->fw * gif->fh / ((double)gif->width * gif->height);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+    auto percentile = [&samples](double percent) {
+        return samples[std::min(samples.size() - 1, (size_t)(samples.size() * percent / 100))];
+    };
+    printf("%-10s %4ux%-4u %8.2f %8.2f %8.2f %8.2f %8.0f%%\n", asset.name, gif->width, gif->height,
+        sum / samples.size(), percentile(50), percentile(99), samples.back(), changed * 100 / samples.size());
+    gd_close_gif(gif);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 500;
+    if (frames <= 0) {
+        fprintf(stderr, "usage: %s [frames_per_gif]\n", argv[0]);
+        return 1;
+    }
+
+    lv_init();
+    printf("%d frames per GIF, decode + render time in ms\n", frames);
+    printf("%-10s %9s %8s %8s %8s %8s %9s\n", "gif", "size", "mean", "p50", "p99", "max", "changed");
+    bool ok = true;
+    for (auto& asset : kAssets) {
+        ok = Bench(asset, frames) && ok;
+    }
+    lv_deinit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+/*
+ * Cost of handing the AFE output to the encoder: 512-sample fetches at 16 kHz re-framed into
+ * 20, 40 and 60 ms encoder frames, PcmFramer against the vector insert/erase it replaced.
+ *
+ * The consumer swaps a recycled buffer back in, like AudioService does with its pooled tasks,
+ * so the framer should not allocate at all in steady state.
+ *
+ * Usage: bench_pcm_framer [frames]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "pcm_framer.h"
+
+#define SAMPLE_RATE 16000
+#define AFE_FETCH_SAMPLES 512
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    double ns_per_frame;
+    double allocations_per_frame;
+    uint64_t checksum;
+};
+
+template <typename Framing>
+static Result Measure(int frames, size_t frame_samples, Framing framing) {
+    std::vector<int16_t> chunk(AFE_FETCH_SAMPLES);
+    for (size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = (int16_t)i;
+    }
+    std::vector<int16_t> recycled;
+    recycled.reserve(frame_samples);
+    uint64_t checksum = 0;
+    int emitted = 0;
+    auto consume = [&](std::vector<int16_t>& frame) {
+        checksum = checksum * 31 + frame.size() + frame.front() + frame.back();
+        recycled.swap(frame);
+        recycled.clear();
+        emitted++;
+    };
+
+    size_t chunks = (size_t)frames * frame_samples / AFE_FETCH_SAMPLES;
+    uint64_t allocations = HostAllocationCount();
+    auto start = Clock::now();
+    for (size_t n = 0; n < chunks; n++) {
+        framing(chunk, consume);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    allocations = HostAllocationCount() - allocations;
+    if (emitted == 0) {
+        return {0, 0, checksum};
+    }
+    return {(double)elapsed / emitted, (double)allocations / emitted, checksum};
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 100000;
+    if (frames <= 0) {
+        fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d frames of %d-sample AFE fetches at %d Hz\n", frames, AFE_FETCH_SAMPLES, SAMPLE_RATE);
+    printf("%-6s %-14s %12s %14s\n", "frame", "framing", "ns/frame", "allocs/frame");
+    int status = 0;
+    for (int duration_ms : {20, 40, 60}) {
+        size_t frame_samples = duration_ms * SAMPLE_RATE / 1000;
+
+        // The previous implementation, insert at the end and erase from the front
+        std::vector<int16_t> buffer;
+        buffer.reserve(frame_samples);
+        auto legacy = Measure(frames, frame_samples, [&](const std::vector<int16_t>& chunk, auto& consume) {
+            buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+            while (buffer.size() >= frame_samples) {
+                if (buffer.size() == frame_samples) {
+                    consume(buffer);
+                    buffer.clear();
+                    buffer.reserve(frame_samples);
+                } else {
+                    std::vector<int16_t> frame(buffer.begin(), buffer.begin() + frame_samples);
+                    consume(frame);
+                    buffer.erase(buffer.begin(), buffer.begin() + frame_samples);
+                }
+            }
+        });
+
+        PcmFramer framer;
+        framer.SetFrameSamples(frame_samples);
+        auto framed = Measure(frames, frame_samples, [&](const std::vector<int16_t>& chunk, auto& consume) {
+            framer.Push(chunk.data(), chunk.size(), consume);
+        });
+
+        char name[8];
+        snprintf(name, sizeof(name), "%dms", duration_ms);
+        printf("%-6s %-14s %12.1f %14.2f\n", name, "insert/erase", legacy.ns_per_frame, legacy.allocations_per_frame);
+        printf("%-6s %-14s %12.1f %14.2f\n", name, "PcmFramer", framed.ns_per_frame, framed.allocations_per_frame);
+        if (framed.checksum != legacy.checksum) {
+            fprintf(stderr, "%s: PcmFramer emitted different frames than insert/erase\n", name);
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,162 @@
+/*
+ * Enqueue-to-dequeue latency of SpscRing against the mutex + deque + shared condition variable
+ * queue it replaced, while other threads keep the CPUs busy.
+ *
+ * A producer pushes its timestamp at a fixed period, like an audio task handing over frames,
+ * and the consumer records how long each item waited. For the mutex queue, extra threads wait
+ * on the same condition variable, as the other audio tasks did, so every push wakes them all.
+ *
+ * Usage: bench_spsc_ring [items] [period_us] [load_threads]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void Report(const char* name, std::vector<int64_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+    double mean = sum / samples.size();
+    double variance = 0;
+    for (auto sample : samples) {
+        variance += (sample - mean) * (sample - mean);
+    }
+    auto percentile = [&samples](double percent) {
+        size_t index = std::min(samples.size() - 1, (size_t)(samples.size() * percent / 100));
+        return samples[index] / 1000.0;
+    };
+    printf("%-22s %8.1f %8.1f %8.1f %8.1f %9.1f %8.1f\n", name, mean / 1000, percentile(50), percentile(99),
+        percentile(99.9), samples.back() / 1000.0, std::sqrt(variance / samples.size()) / 1000);
+}
+
+template <typename Push>
+static void Produce(int items, int period_us, Push push) {
+    auto next = Clock::now();
+    for (int i = 0; i < items; i++) {
+        next += std::chrono::microseconds(period_us);
+        std::this_thread::sleep_until(next);
+        push(NowNs());
+    }
+}
+
+static std::vector<int64_t> RunSpscRing(int items, int period_us) {
+    SpscRing<int64_t, 8> ring;
+    std::vector<int64_t> samples;
+    samples.reserve(items);
+
+    std::thread consumer([&]() {
+        ring.SetConsumerTask(xTaskGetCurrentTaskHandle());
+        while ((int)samples.size() < items) {
+            int64_t pushed;
+            if (!ring.Pop(pushed)) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                continue;
+            }
+            samples.push_back(NowNs() - pushed);
+        }
+        ring.SetConsumerTask(nullptr);
+    });
+    ring.SetProducerTask(xTaskGetCurrentTaskHandle());
+    Produce(items, period_us, [&ring](int64_t now) {
+        while (!ring.Push(std::move(now))) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    });
+    consumer.join();
+    ring.SetProducerTask(nullptr);
+    return samples;
+}
+
+static std::vector<int64_t> RunMutexQueue(int items, int period_us, int bystanders) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<int64_t> queue;
+    bool done = false;
+    std::vector<int64_t> samples;
+    samples.reserve(items);
+
+    // The other audio tasks, each waiting for its own queue on the shared condition variable
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < bystanders; i++) {
+        waiters.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return done; });
+        });
+    }
+    std::thread consumer([&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while ((int)samples.size() < items) {
+            cv.wait(lock, [&]() { return !queue.empty(); });
+            samples.push_back(NowNs() - queue.front());
+            queue.pop_front();
+        }
+    });
+    Produce(items, period_us, [&](int64_t now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(now);
+        cv.notify_all();
+    });
+    consumer.join();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cv.notify_all();
+    }
+    for (auto& waiter : waiters) {
+        waiter.join();
+    }
+    return samples;
+}
+
+int main(int argc, char** argv) {
+    int items = argc > 1 ? atoi(argv[1]) : 20000;
+    int period_us = argc > 2 ? atoi(argv[2]) : 250;
+    int load_threads = argc > 3 ? atoi(argv[3]) : (int)std::thread::hardware_concurrency();
+    if (items <= 0 || period_us <= 0 || load_threads < 0) {
+        fprintf(stderr, "usage: %s [items] [period_us] [load_threads]\n", argv[0]);
+        return 1;
+    }
+
+    // Busy threads competing with the producer and consumer for the CPUs
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> load;
+    for (int i = 0; i < load_threads; i++) {
+        load.emplace_back([&stop]() {
+            volatile uint64_t counter = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                counter = counter + 1;
+            }
+        });
+    }
+
+    printf("%d items every %d us, %d load threads, latency in us\n", items, period_us, load_threads);
+    printf("%-22s %8s %8s %8s %8s %9s %8s\n", "queue", "mean", "p50", "p99", "p99.9", "max", "stddev");
+    auto spsc = RunSpscRing(items, period_us);
+    Report("SpscRing", spsc);
+    auto mutex_queue = RunMutexQueue(items, period_us, 3);
+    Report("mutex+deque+cv", mutex_queue);
+
+    stop = true;
+    for (auto& thread : load) {
+        thread.join();
+    }
+    return 0;
+}
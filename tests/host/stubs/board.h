@@ -0,0 +1,6 @@
+#ifndef HOST_BOARD_H
+#define HOST_BOARD_H
+
+/* audio_codec.h includes board.h, the host builds of the audio classes never reach the Board */
+
+#endif // HOST_BOARD_H
@@ -0,0 +1,24 @@
+#ifndef HOST_CJSON_H
+#define HOST_CJSON_H
+
+/*
+ * The cJSON calls main/ makes to build and print documents, implemented by host_cjson.cc.
+ * protocol.h only passes cJSON pointers around, so tests that never build a tree need not link it.
+ */
+
+typedef struct cJSON cJSON;
+typedef int cJSON_bool;
+
+cJSON* cJSON_CreateObject(void);
+cJSON* cJSON_CreateArray(void);
+cJSON* cJSON_CreateNumber(double num);
+cJSON* cJSON_CreateString(const char* string);
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item);
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item);
+cJSON* cJSON_AddNumberToObject(cJSON* const object, const char* const name, const double number);
+cJSON* cJSON_AddStringToObject(cJSON* const object, const char* const name, const char* const string);
+char* cJSON_PrintUnformatted(const cJSON* item);
+void cJSON_free(void* object);
+void cJSON_Delete(cJSON* item);
+
+#endif // HOST_CJSON_H
@@ -0,0 +1,19 @@
+#ifndef HOST_DRIVER_I2S_COMMON_H
+#define HOST_DRIVER_I2S_COMMON_H
+
+/* No I2S on the host, codecs there read and write memory and never open a channel */
+
+#include "esp_err.h"
+
+struct i2s_channel_obj_t;
+typedef struct i2s_channel_obj_t* i2s_chan_handle_t;
+
+static inline esp_err_t i2s_channel_enable(i2s_chan_handle_t) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t i2s_channel_disable(i2s_chan_handle_t) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // HOST_DRIVER_I2S_COMMON_H
@@ -0,0 +1,24 @@
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+/* The host has one heap, every capability is served by malloc */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+static inline void* heap_caps_malloc(size_t size, uint32_t) {
+    return malloc(size);
+}
+
+static inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+#endif // HOST_ESP_HEAP_CAPS_H
@@ -0,0 +1,19 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+/* Just enough of FreeRTOS for the host tests, one tick is one millisecond */
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,29 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+/* Every std::thread is a task, with a counting notification like xTaskNotifyGive / ulTaskNotifyTake */
+struct HostTask;
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define tskNO_AFFINITY 0x7fffffff
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+
+/* Runs `function` on a new thread, the stack size, priority and core are ignored */
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, TaskHandle_t* created_task);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+/* Only NULL (the calling task) is supported, the thread ends when its function returns */
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+/* Host only: blocks until every task started by xTaskCreate has returned */
+void HostWaitForTasks();
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,145 @@
+#include "cJSON.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct cJSON {
+    enum Type { kObject, kArray, kNumber, kString } type;
+    std::string name;
+    double number = 0;
+    std::string string;
+    std::vector<cJSON*> children;
+};
+
+static cJSON* Create(cJSON::Type type) {
+    auto item = new cJSON;
+    item->type = type;
+    return item;
+}
+
+cJSON* cJSON_CreateObject(void) {
+    return Create(cJSON::kObject);
+}
+
+cJSON* cJSON_CreateArray(void) {
+    return Create(cJSON::kArray);
+}
+
+cJSON* cJSON_CreateNumber(double num) {
+    auto item = Create(cJSON::kNumber);
+    item->number = num;
+    return item;
+}
+
+cJSON* cJSON_CreateString(const char* string) {
+    auto item = Create(cJSON::kString);
+    item->string = string;
+    return item;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == nullptr || item == nullptr) {
+        return 0;
+    }
+    array->children.push_back(item);
+    return 1;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item) {
+    if (object == nullptr || item == nullptr) {
+        return 0;
+    }
+    item->name = string;
+    object->children.push_back(item);
+    return 1;
+}
+
+cJSON* cJSON_AddNumberToObject(cJSON* const object, const char* const name, const double number) {
+    auto item = cJSON_CreateNumber(number);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddStringToObject(cJSON* const object, const char* const name, const char* const string) {
+    auto item = cJSON_CreateString(string);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+static void PrintString(const std::string& string, std::string& out) {
+    out += '"';
+    for (unsigned char c : string) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+static void Print(const cJSON* item, std::string& out) {
+    switch (item->type) {
+    case cJSON::kNumber: {
+        // Like cJSON: 15 significant digits unless they do not read back as the same number
+        char number[32];
+        snprintf(number, sizeof(number), "%1.15g", item->number);
+        if (strtod(number, nullptr) != item->number) {
+            snprintf(number, sizeof(number), "%1.17g", item->number);
+        }
+        out += number;
+        break;
+    }
+    case cJSON::kString:
+        PrintString(item->string, out);
+        break;
+    case cJSON::kObject:
+    case cJSON::kArray: {
+        bool object = item->type == cJSON::kObject;
+        out += object ? '{' : '[';
+        for (size_t i = 0; i < item->children.size(); i++) {
+            if (i > 0) {
+                out += ',';
+            }
+            if (object) {
+                PrintString(item->children[i]->name, out);
+                out += ':';
+            }
+            Print(item->children[i], out);
+        }
+        out += object ? '}' : ']';
+        break;
+    }
+    }
+}
+
+char* cJSON_PrintUnformatted(const cJSON* item) {
+    if (item == nullptr) {
+        return nullptr;
+    }
+    std::string out;
+    Print(item, out);
+    return strdup(out.c_str());
+}
+
+void cJSON_free(void* object) {
+    free(object);
+}
+
+void cJSON_Delete(cJSON* item) {
+    if (item == nullptr) {
+        return;
+    }
+    for (auto child : item->children) {
+        cJSON_Delete(child);
+    }
+    delete item;
+}
@@ -0,0 +1,103 @@
+#include "esp_timer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+struct HostTimer {
+    esp_timer_create_args_t args;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    bool armed = false;
+    bool deleted = false;
+    Clock::time_point deadline;
+    std::chrono::microseconds period{0};  // 0 for one-shot
+};
+
+int64_t esp_timer_get_time() {
+    static const auto start = Clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+static void TimerThread(HostTimer* timer) {
+    std::unique_lock<std::mutex> lock(timer->mutex);
+    while (!timer->deleted) {
+        if (!timer->armed) {
+            timer->cv.wait(lock);
+            continue;
+        }
+        if (timer->cv.wait_until(lock, timer->deadline) != std::cv_status::timeout || !timer->armed) {
+            continue;
+        }
+        if (timer->period.count() > 0) {
+            // Missed periods are skipped, as with skip_unhandled_events
+            do {
+                timer->deadline += timer->period;
+            } while (timer->deadline <= Clock::now());
+        } else {
+            timer->armed = false;
+        }
+        lock.unlock();
+        timer->args.callback(timer->args.arg);
+        lock.lock();
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    auto timer = new HostTimer;
+    timer->args = *args;
+    timer->thread = std::thread(TimerThread, timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t Start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->deadline = Clock::now() + std::chrono::microseconds(timeout_us);
+    timer->period = std::chrono::microseconds(period_us);
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return Start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return Start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (!timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    {
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        timer->armed = false;
+        timer->deleted = true;
+        timer->cv.notify_all();
+    }
+    if (timer->thread.get_id() == std::this_thread::get_id()) {
+        // Deleted from its own callback, the thread sees `deleted` once the callback returns
+        timer->thread.detach();
+        return ESP_OK;
+    }
+    timer->thread.join();
+    delete timer;
+    return ESP_OK;
+}
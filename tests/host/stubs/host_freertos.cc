@@ -0,0 +1,141 @@
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct HostTask {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t value = 0;
+};
+
+// Set before a created task runs, so its handle is the one xTaskCreate returned
+static thread_local HostTask* current_task = nullptr;
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // Never freed, a peer may still notify a thread that has just exited
+    if (current_task == nullptr) {
+        current_task = new HostTask;
+    }
+    return current_task;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->value++;
+    }
+    task->cv.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    auto task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    auto ready = [task]() { return task->value > 0; };
+    if (ticks_to_wait == portMAX_DELAY) {
+        task->cv.wait(lock, ready);
+    } else {
+        task->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), ready);
+    }
+    uint32_t value = task->value;
+    if (value > 0) {
+        task->value = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+static std::mutex tasks_mutex;
+static std::condition_variable tasks_cv;
+static int running_tasks = 0;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char*, uint32_t, void* arg,
+    UBaseType_t, TaskHandle_t* created_task, BaseType_t) {
+    auto task = new HostTask;
+    if (created_task != nullptr) {
+        *created_task = task;
+    }
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        running_tasks++;
+    }
+    std::thread([function, arg, task]() {
+        current_task = task;
+        function(arg);
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        running_tasks--;
+        tasks_cv.notify_all();
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, TaskHandle_t* created_task) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void HostWaitForTasks() {
+    std::unique_lock<std::mutex> lock(tasks_mutex);
+    tasks_cv.wait(lock, []() { return running_tasks == 0; });
+}
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto ready = [&]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    if (ticks_to_wait == portMAX_DELAY) {
+        group->cv.wait(lock, ready);
+    } else {
+        group->cv.wait_for(lock, std::chrono::milliseconds(ticks_to_wait), ready);
+    }
+    EventBits_t result = group->bits;
+    if (clear_on_exit && ready()) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
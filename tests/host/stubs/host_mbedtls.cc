@@ -0,0 +1,50 @@
+#include "mbedtls/aes.h"
+
+#include <openssl/evp.h>
+
+void mbedtls_aes_init(mbedtls_aes_context* ctx) {
+    ctx->cipher = nullptr;
+}
+
+void mbedtls_aes_free(mbedtls_aes_context* ctx) {
+    EVP_CIPHER_CTX_free((EVP_CIPHER_CTX*)ctx->cipher);
+    ctx->cipher = nullptr;
+}
+
+int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits) {
+    if (keybits != 128) {
+        return -1;
+    }
+    mbedtls_aes_free(ctx);
+    auto cipher = EVP_CIPHER_CTX_new();
+    if (cipher == nullptr || EVP_EncryptInit_ex(cipher, EVP_aes_128_ecb(), nullptr, key, nullptr) != 1) {
+        EVP_CIPHER_CTX_free(cipher);
+        return -1;
+    }
+    EVP_CIPHER_CTX_set_padding(cipher, 0);
+    ctx->cipher = cipher;
+    return 0;
+}
+
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context* ctx, size_t length, size_t* nc_off, unsigned char nonce_counter[16],
+    unsigned char stream_block[16], const unsigned char* input, unsigned char* output) {
+    if (ctx->cipher == nullptr || *nc_off > 15) {
+        return -1;
+    }
+    size_t n = *nc_off;
+    for (size_t i = 0; i < length; i++) {
+        if (n == 0) {
+            int size = 0;
+            if (EVP_EncryptUpdate((EVP_CIPHER_CTX*)ctx->cipher, stream_block, &size, nonce_counter, 16) != 1 || size != 16) {
+                return -1;
+            }
+            // The whole block is one big-endian counter
+            for (int j = 15; j >= 0 && ++nonce_counter[j] == 0; j--) {
+            }
+        }
+        output[i] = input[i] ^ stream_block[n];
+        n = (n + 1) & 0x0f;
+    }
+    *nc_off = n;
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "opus_encoder.h"
+#include "opus_decoder.h"
+#include "opus_resampler.h"
+
+#include <cstdlib>
+
+// G.711 mu-law, as in the ITU-T reference implementation
+static uint8_t MuLawEncode(int16_t sample) {
+    const int kBias = 0x84;
+    const int kClip = 32635;
+    int pcm = sample;
+    int sign = (pcm >> 8) & 0x80;
+    if (sign) {
+        pcm = -pcm;
+    }
+    if (pcm > kClip) {
+        pcm = kClip;
+    }
+    pcm += kBias;
+    int exponent = 7;
+    for (int mask = 0x4000; (pcm & mask) == 0 && exponent > 0; mask >>= 1) {
+        exponent--;
+    }
+    int mantissa = (pcm >> (exponent + 3)) & 0x0f;
+    return ~(sign | (exponent << 4) | mantissa);
+}
+
+static int16_t MuLawDecode(uint8_t value) {
+    value = ~value;
+    int sign = value & 0x80;
+    int exponent = (value >> 4) & 0x07;
+    int mantissa = value & 0x0f;
+    int sample = (((mantissa << 3) + 0x84) << exponent) - 0x84;
+    return sign ? -sample : sample;
+}
+
+OpusEncoderWrapper::OpusEncoderWrapper(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), duration_ms_(duration_ms) {
+    frame_size_ = (size_t)sample_rate * channels * duration_ms / 1000;
+    in_buffer_.reserve(frame_size_);
+}
+
+bool OpusEncoderWrapper::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    if (pcm.size() != frame_size_) {
+        return false;
+    }
+    opus.resize(pcm.size());
+    for (size_t i = 0; i < pcm.size(); i++) {
+        opus[i] = MuLawEncode(pcm[i]);
+    }
+    return true;
+}
+
+void OpusEncoderWrapper::Encode(std::vector<int16_t>&& pcm, std::function<void(std::vector<uint8_t>&& opus)> handler) {
+    in_buffer_.insert(in_buffer_.end(), pcm.begin(), pcm.end());
+    size_t offset = 0;
+    while (in_buffer_.size() - offset >= frame_size_) {
+        std::vector<uint8_t> opus(frame_size_);
+        for (size_t i = 0; i < frame_size_; i++) {
+            opus[i] = MuLawEncode(in_buffer_[offset + i]);
+        }
+        offset += frame_size_;
+        handler(std::move(opus));
+    }
+    in_buffer_.erase(in_buffer_.begin(), in_buffer_.begin() + offset);
+}
+
+OpusDecoderWrapper::OpusDecoderWrapper(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), duration_ms_(duration_ms) {
+    frame_size_ = (size_t)sample_rate * channels * duration_ms / 1000;
+}
+
+bool OpusDecoderWrapper::Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm) {
+    if (opus.empty()) {
+        pcm.assign(frame_size_, 0);
+        return true;
+    }
+    if (opus.size() > frame_size_) {
+        return false;
+    }
+    pcm.resize(opus.size());
+    for (size_t i = 0; i < opus.size(); i++) {
+        pcm[i] = MuLawDecode(opus[i]);
+    }
+    return true;
+}
+
+void OpusResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    last_sample_ = 0;
+}
+
+int OpusResampler::GetOutputSamples(int input_samples) const {
+    if (input_sample_rate_ <= 0) {
+        return input_samples;
+    }
+    return (int64_t)input_samples * output_sample_rate_ / input_sample_rate_;
+}
+
+void OpusResampler::Process(const int16_t* input, int input_samples, int16_t* output) {
+    int output_samples = GetOutputSamples(input_samples);
+    if (input_samples <= 0 || output_samples <= 0) {
+        return;
+    }
+    // Output sample i sits at input position (i + 1) * in / out - 1, the sample before the
+    // chunk is the last one of the previous call
+    for (int i = 0; i < output_samples; i++) {
+        int64_t position = (int64_t)(i + 1) * input_sample_rate_ * 256 / output_sample_rate_ - 256;
+        int index = position >> 8;
+        int fraction = position & 0xff;
+        int a = index < 0 ? last_sample_ : input[index];
+        int b = input[index + 1 < input_samples ? index + 1 : input_samples - 1];
+        output[i] = (int16_t)(a + (((b - a) * fraction) >> 8));
+    }
+    last_sample_ = input[input_samples - 1];
+}
@@ -0,0 +1,55 @@
+#include "settings.h"
+
+#include <map>
+#include <mutex>
+
+static std::mutex mutex;
+static std::map<std::string, std::map<std::string, std::string>> strings;
+static std::map<std::string, std::map<std::string, int32_t>> ints;
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& values = strings[ns_];
+    auto it = values.find(key);
+    return it != values.end() ? it->second : default_value;
+}
+
+void Settings::SetString(const std::string& key, const std::string& value) {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(mutex);
+        strings[ns_][key] = value;
+    }
+}
+
+int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& values = ints[ns_];
+    auto it = values.find(key);
+    return it != values.end() ? it->second : default_value;
+}
+
+void Settings::SetInt(const std::string& key, int32_t value) {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ints[ns_][key] = value;
+    }
+}
+
+void Settings::EraseKey(const std::string& key) {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(mutex);
+        strings[ns_].erase(key);
+        ints[ns_].erase(key);
+    }
+}
+
+void Settings::EraseAll() {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(mutex);
+        strings.erase(ns_);
+        ints.erase(ns_);
+    }
+}
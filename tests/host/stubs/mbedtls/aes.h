@@ -0,0 +1,22 @@
+#ifndef HOST_MBEDTLS_AES_H
+#define HOST_MBEDTLS_AES_H
+
+/*
+ * The part of the mbedtls AES API that main/ uses, on top of OpenSSL's AES block cipher.
+ * The CTR mode, counter increment and stream offset follow mbedtls_aes_crypt_ctr().
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+typedef struct {
+    void* cipher;   // EVP_CIPHER_CTX running AES-128-ECB on single blocks
+} mbedtls_aes_context;
+
+void mbedtls_aes_init(mbedtls_aes_context* ctx);
+void mbedtls_aes_free(mbedtls_aes_context* ctx);
+int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits);
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context* ctx, size_t length, size_t* nc_off, unsigned char nonce_counter[16],
+    unsigned char stream_block[16], const unsigned char* input, unsigned char* output);
+
+#endif // HOST_MBEDTLS_AES_H
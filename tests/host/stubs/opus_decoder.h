@@ -0,0 +1,26 @@
+#ifndef HOST_OPUS_DECODER_H
+#define HOST_OPUS_DECODER_H
+
+/* Stand-in for the esp-opus-encoder decoder wrapper, expands the mu-law frames of opus_encoder.h */
+
+#include <cstdint>
+#include <vector>
+
+class OpusDecoderWrapper {
+public:
+    OpusDecoderWrapper(int sample_rate, int channels, int duration_ms = 60);
+
+    /* An empty packet conceals a lost frame, with silence here */
+    bool Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm);
+    void ResetState() {}
+
+    int sample_rate() const { return sample_rate_; }
+    int duration_ms() const { return duration_ms_; }
+
+private:
+    int sample_rate_;
+    int duration_ms_;
+    size_t frame_size_;
+};
+
+#endif // HOST_OPUS_DECODER_H
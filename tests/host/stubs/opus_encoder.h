@@ -0,0 +1,40 @@
+#ifndef HOST_OPUS_ENCODER_H
+#define HOST_OPUS_ENCODER_H
+
+/*
+ * Stand-in for the esp-opus-encoder wrapper with the same API. libopus is not available to the
+ * host build, so frames are companded to 8-bit G.711 mu-law instead: deterministic, cheap, and
+ * decodable by the matching OpusDecoderWrapper. Pipeline numbers measured with it leave out the
+ * cost of Opus itself.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class OpusEncoderWrapper {
+public:
+    OpusEncoderWrapper(int sample_rate, int channels, int duration_ms = 60);
+
+    void SetDtx(bool enable) { dtx_ = enable; }
+    void SetComplexity(int complexity) { complexity_ = complexity; }
+    /* `pcm` must hold exactly one frame */
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus);
+    /* Buffers `pcm` and hands every complete frame to `handler` */
+    void Encode(std::vector<int16_t>&& pcm, std::function<void(std::vector<uint8_t>&& opus)> handler);
+    bool IsBufferEmpty() const { return in_buffer_.empty(); }
+    void ResetState() { in_buffer_.clear(); }
+
+    int sample_rate() const { return sample_rate_; }
+    int duration_ms() const { return duration_ms_; }
+
+private:
+    int sample_rate_;
+    int duration_ms_;
+    size_t frame_size_;
+    bool dtx_ = false;
+    int complexity_ = 0;
+    std::vector<int16_t> in_buffer_;
+};
+
+#endif // HOST_OPUS_ENCODER_H
@@ -0,0 +1,23 @@
+#ifndef HOST_OPUS_RESAMPLER_H
+#define HOST_OPUS_RESAMPLER_H
+
+/* Stand-in for the esp-opus-encoder resampler with the same API, linear interpolation */
+
+#include <cstdint>
+
+class OpusResampler {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate);
+    void Process(const int16_t* input, int input_samples, int16_t* output);
+    int GetOutputSamples(int input_samples) const;
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int16_t last_sample_ = 0;
+};
+
+#endif // HOST_OPUS_RESAMPLER_H
@@ -0,0 +1,6 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+/* The host targets set the CONFIG_ options they need as compile definitions in CMakeLists.txt */
+
+#endif // HOST_SDKCONFIG_H
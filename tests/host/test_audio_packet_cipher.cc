@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "audio_packet_cipher.h"
+
+namespace {
+
+std::string FromHex(const std::string& hex) {
+    std::string bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        bytes.push_back((char)std::stoi(hex.substr(i, 2), nullptr, 16));
+    }
+    return bytes;
+}
+
+std::string ToHex(const std::string& bytes) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : bytes) {
+        hex.push_back(kDigits[c >> 4]);
+        hex.push_back(kDigits[c & 0x0f]);
+    }
+    return hex;
+}
+
+std::vector<uint8_t> ToVector(const std::string& bytes) {
+    return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+// Key and nonce as a server hello would send them: type 1, ssrc 0x11223344, the rest zero
+const std::string kKey = FromHex("000102030405060708090a0b0c0d0e0f");
+const std::string kNonce = FromHex("01000000112233440000000000000000");
+
+struct DatagramVector {
+    uint32_t timestamp;
+    uint32_t sequence;
+    std::string payload;
+    std::string datagram_hex;
+};
+
+const DatagramVector kVectors[] = {
+    // Crosses a block boundary
+    {0x00012345, 1, "xiaozhi opus frame",
+        "01000012112233440001234500000001" "41cc3dffe4b000eaa8bc932b9bee198f3aa8"},
+    // The counter carries from the sequence into the timestamp within the datagram
+    {0x0000ffff, 0xffffffff, FromHex("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f2021222324252627"),
+        "01000028112233440000ffffffffffff"
+        "1f37616f01d29961744e9193b7e3f221aae4d7384564eebdf211b4a8221c38c81a85740597953b32"},
+    // Header only
+    {7, 2, "", "01000000112233440000000700000002"},
+};
+
+}  // namespace
+
+TEST(AudioPacketCipher, EncryptMatchesKnownDatagrams) {
+    AudioPacketCipher cipher;
+    ASSERT_TRUE(cipher.SetKey(kKey, kNonce));
+    std::string datagram;
+    for (auto& vector : kVectors) {
+        AudioStreamPacket packet;
+        packet.timestamp = vector.timestamp;
+        packet.payload = ToVector(vector.payload);
+        ASSERT_TRUE(cipher.Encrypt(packet, vector.sequence, datagram));
+        EXPECT_EQ(ToHex(datagram), vector.datagram_hex) << vector.sequence;
+    }
+}
+
+TEST(AudioPacketCipher, DecryptMatchesKnownDatagrams) {
+    AudioPacketCipher cipher;
+    ASSERT_TRUE(cipher.SetKey(kKey, kNonce));
+    std::vector<uint8_t> payload;
+    for (auto& vector : kVectors) {
+        auto datagram = FromHex(vector.datagram_hex);
+        ASSERT_TRUE(cipher.Decrypt((const uint8_t*)datagram.data(), datagram.size(), payload));
+        EXPECT_EQ(payload, ToVector(vector.payload)) << vector.sequence;
+    }
+}
+
+TEST(AudioPacketCipher, NistCtrVector) {
+    // NIST SP 800-38A F.5.2 CTR-AES128.Decrypt, the initial counter block sent as the header
+    AudioPacketCipher cipher;
+    ASSERT_TRUE(cipher.SetKey(FromHex("2b7e151628aed2a6abf7158809cf4f3c"), kNonce));
+    auto datagram = FromHex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"
+        "874d6191b620e3261bef6864990db6ce" "9806f66b7970fdff8617187bb9fffdff"
+        "5ae4df3edbd5d35e5b4f09020db03eab" "1e031dda2fbe03d1792170a0f3009cee");
+    std::vector<uint8_t> plaintext;
+    ASSERT_TRUE(cipher.Decrypt((const uint8_t*)datagram.data(), datagram.size(), plaintext));
+    EXPECT_EQ(ToHex(std::string(plaintext.begin(), plaintext.end())),
+        "6bc1bee22e409f96e93d7e117393172a" "ae2d8a571e03ac9c9eb76fac45af8e51"
+        "30c81c46a35ce411e5fbc1191a0a52ef" "f69f2445df4f9b17ad2b417be66c3710");
+}
+
+TEST(AudioPacketCipher, RejectsMissingKeyAndShortDatagrams) {
+    AudioPacketCipher cipher;
+    AudioStreamPacket packet;
+    packet.payload = {1, 2, 3};
+    std::string datagram;
+    std::vector<uint8_t> payload;
+    EXPECT_FALSE(cipher.Encrypt(packet, 1, datagram));
+    auto valid = FromHex(kVectors[0].datagram_hex);
+    EXPECT_FALSE(cipher.Decrypt((const uint8_t*)valid.data(), valid.size(), payload));
+
+    EXPECT_FALSE(cipher.SetKey(kKey.substr(0, 15), kNonce));
+    EXPECT_FALSE(cipher.SetKey(kKey, kNonce.substr(0, 8)));
+    ASSERT_TRUE(cipher.SetKey(kKey, kNonce));
+    EXPECT_FALSE(cipher.Decrypt((const uint8_t*)valid.data(), AUDIO_PACKET_HEADER_SIZE - 1, payload));
+}
+
+TEST(AudioPacketCipher, BuffersAreReused) {
+    AudioPacketCipher cipher;
+    ASSERT_TRUE(cipher.SetKey(kKey, kNonce));
+    AudioStreamPacket packet;
+    packet.payload.assign(100, 0x5a);
+    std::string datagram;
+    ASSERT_TRUE(cipher.Encrypt(packet, 1, datagram));
+    auto data = datagram.data();
+    std::vector<uint8_t> payload;
+    ASSERT_TRUE(cipher.Decrypt((const uint8_t*)datagram.data(), datagram.size(), payload));
+    EXPECT_EQ(payload, packet.payload);
+    auto payload_data = payload.data();
+
+    // A smaller packet in the same buffers does not reallocate them
+    packet.payload.assign(40, 0xa5);
+    ASSERT_TRUE(cipher.Encrypt(packet, 2, datagram));
+    EXPECT_EQ(datagram.data(), data);
+    ASSERT_TRUE(cipher.Decrypt((const uint8_t*)datagram.data(), datagram.size(), payload));
+    EXPECT_EQ(payload.data(), payload_data);
+    EXPECT_EQ(payload, packet.payload);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "control_message.h"
+
+namespace {
+
+ControlMessage MakeMessage(ControlMessageType type, uint8_t state, uint8_t param, const std::string& text) {
+    ControlMessage message;
+    message.type = type;
+    message.state = state;
+    message.param = param;
+    if (!text.empty()) {
+        message.text = JsonValue(kJsonString, text.data(), text.size());
+    }
+    return message;
+}
+
+std::vector<uint8_t> Encode(const ControlMessage& message, size_t buffer_size = 256) {
+    std::vector<uint8_t> buffer(buffer_size);
+    size_t size = EncodeControlMessage(message, buffer.data(), buffer.size());
+    buffer.resize(size);
+    return buffer;
+}
+
+/* Encodes, checks the layout, decodes again and compares field by field */
+void ExpectRoundTrip(const ControlMessage& message) {
+    auto frame = Encode(message);
+    size_t text_length = message.text.IsString() ? message.text.length() : 0;
+    ASSERT_EQ(frame.size(), CONTROL_MESSAGE_HEADER_SIZE + text_length);
+    EXPECT_EQ(frame[0], message.type);
+    EXPECT_EQ(frame[1], message.state);
+    EXPECT_EQ(frame[2], message.param);
+
+    ControlMessage decoded;
+    ASSERT_TRUE(DecodeControlMessage(frame.data(), frame.size(), decoded));
+    EXPECT_EQ(decoded.type, message.type);
+    EXPECT_EQ(decoded.state, message.state);
+    EXPECT_EQ(decoded.param, message.param);
+    EXPECT_TRUE(decoded.text.IsString());
+    EXPECT_EQ(decoded.text.ToString(), text_length > 0 ? message.text.ToString() : "");
+    // The decoded text points into the frame, it is not copied
+    EXPECT_EQ((const uint8_t*)decoded.text.data(), frame.data() + CONTROL_MESSAGE_HEADER_SIZE);
+}
+
+/* The binary and JSON forms of the same message must decode to the same fields */
+void ExpectSameAsJson(const std::string& json, const ControlMessage& message) {
+    JsonReader root(json.data(), json.size());
+    ControlMessage parsed;
+    ASSERT_TRUE(ParseControlMessage(root, parsed)) << json;
+    auto frame = Encode(message);
+    ControlMessage decoded;
+    ASSERT_TRUE(DecodeControlMessage(frame.data(), frame.size(), decoded));
+    EXPECT_EQ(parsed.type, decoded.type) << json;
+    EXPECT_EQ(parsed.state, decoded.state) << json;
+    EXPECT_EQ(parsed.param, decoded.param) << json;
+    std::string parsed_text = parsed.text.IsString() ? parsed.text.ToString() : "";
+    EXPECT_EQ(parsed_text, decoded.text.ToString()) << json;
+}
+
+}  // namespace
+
+TEST(ControlMessage, ListenRoundTrip) {
+    for (uint8_t state : {kControlListenStart, kControlListenStop, kControlListenDetect}) {
+        for (uint8_t mode = 0; mode <= 2; mode++) {
+            ExpectRoundTrip(MakeMessage(kControlListen, state, mode, ""));
+        }
+    }
+    ExpectRoundTrip(MakeMessage(kControlListen, kControlListenDetect, 0, "你好小智"));
+}
+
+TEST(ControlMessage, AbortRoundTrip) {
+    ExpectRoundTrip(MakeMessage(kControlAbort, 0, 0, ""));
+    ExpectRoundTrip(MakeMessage(kControlAbort, 0, 1, ""));
+}
+
+TEST(ControlMessage, TtsRoundTrip) {
+    ExpectRoundTrip(MakeMessage(kControlTts, kControlTtsStart, 0, ""));
+    ExpectRoundTrip(MakeMessage(kControlTts, kControlTtsStop, 0, ""));
+    ExpectRoundTrip(MakeMessage(kControlTts, kControlTtsSentenceStart, 0, "今天天气不错。"));
+    ExpectRoundTrip(MakeMessage(kControlTts, kControlTtsSentenceEnd, 0, "It is \"sunny\" today."));
+}
+
+TEST(ControlMessage, SttAndLlmRoundTrip) {
+    ExpectRoundTrip(MakeMessage(kControlStt, 0, 0, "what's the weather like"));
+    ExpectRoundTrip(MakeMessage(kControlStt, 0, 0, ""));
+    ExpectRoundTrip(MakeMessage(kControlLlm, 0, 0, "happy"));
+}
+
+TEST(ControlMessage, TextMayContainAnyByte) {
+    // The text runs to the end of the frame, so NUL and quote bytes survive
+    std::string text("a\0b\"c\\d\n", 8);
+    ExpectRoundTrip(MakeMessage(kControlStt, 0, 0, text));
+}
+
+TEST(ControlMessage, MatchesTheJsonForm) {
+    ExpectSameAsJson(R"({"type":"tts","state":"start"})", MakeMessage(kControlTts, kControlTtsStart, 0, ""));
+    ExpectSameAsJson(R"({"type":"tts","state":"stop"})", MakeMessage(kControlTts, kControlTtsStop, 0, ""));
+    ExpectSameAsJson(R"({"type":"tts","state":"sentence_start","text":"hi"})",
+        MakeMessage(kControlTts, kControlTtsSentenceStart, 0, "hi"));
+    ExpectSameAsJson(R"({"type":"tts","state":"sentence_end","text":"hi"})",
+        MakeMessage(kControlTts, kControlTtsSentenceEnd, 0, "hi"));
+    ExpectSameAsJson(R"({"type":"stt","text":"hello"})", MakeMessage(kControlStt, 0, 0, "hello"));
+    ExpectSameAsJson(R"({"type":"llm","emotion":"happy","text":"x"})", MakeMessage(kControlLlm, 0, 0, "happy"));
+    ExpectSameAsJson(R"({"type":"listen","state":"start","mode":"auto"})",
+        MakeMessage(kControlListen, kControlListenStart, 0, ""));
+    ExpectSameAsJson(R"({"type":"listen","state":"start","mode":"manual"})",
+        MakeMessage(kControlListen, kControlListenStart, 1, ""));
+    ExpectSameAsJson(R"({"type":"listen","state":"start","mode":"realtime"})",
+        MakeMessage(kControlListen, kControlListenStart, 2, ""));
+    ExpectSameAsJson(R"({"type":"listen","state":"stop"})", MakeMessage(kControlListen, kControlListenStop, 0, ""));
+    ExpectSameAsJson(R"({"type":"listen","state":"detect","text":"hi"})",
+        MakeMessage(kControlListen, kControlListenDetect, 0, "hi"));
+    ExpectSameAsJson(R"({"type":"abort"})", MakeMessage(kControlAbort, 0, 0, ""));
+    ExpectSameAsJson(R"({"type":"abort","reason":"wake_word_detected"})", MakeMessage(kControlAbort, 0, 1, ""));
+}
+
+TEST(ControlMessage, RejectsUnknownJson) {
+    for (const char* json : {R"({"type":"mcp","payload":{}})", R"({"type":"tts","state":"pause"})",
+             R"({"type":"listen","state":"resume"})", R"({"state":"start"})"}) {
+        JsonReader root(json, strlen(json));
+        ControlMessage message;
+        EXPECT_FALSE(ParseControlMessage(root, message)) << json;
+    }
+}
+
+TEST(ControlMessage, RejectsTruncatedFrames) {
+    auto frame = Encode(MakeMessage(kControlTts, kControlTtsSentenceStart, 0, "hello"));
+    ControlMessage message;
+    EXPECT_FALSE(DecodeControlMessage(frame.data(), 0, message));
+    for (size_t size = 1; size < CONTROL_MESSAGE_HEADER_SIZE; size++) {
+        EXPECT_FALSE(DecodeControlMessage(frame.data(), size, message)) << size;
+    }
+    // A cut in the text still decodes, the text simply ends at the end of the frame
+    ASSERT_TRUE(DecodeControlMessage(frame.data(), CONTROL_MESSAGE_HEADER_SIZE + 2, message));
+    EXPECT_EQ(message.text.ToString(), "he");
+}
+
+TEST(ControlMessage, RejectsUnknownTypes) {
+    ControlMessage message;
+    for (uint8_t type : {(uint8_t)kControlNone, (uint8_t)(kControlLlm + 1), (uint8_t)0xff}) {
+        uint8_t frame[] = {type, 0, 0, 'x'};
+        EXPECT_FALSE(DecodeControlMessage(frame, sizeof(frame), message)) << (int)type;
+    }
+}
+
+TEST(ControlMessage, EncodeRejectsWhatItCannotCarry) {
+    uint8_t buffer[8];
+    // No type
+    EXPECT_EQ(EncodeControlMessage(ControlMessage(), buffer, sizeof(buffer)), 0u);
+    // The header alone does not fit
+    auto abort = MakeMessage(kControlAbort, 0, 1, "");
+    EXPECT_EQ(EncodeControlMessage(abort, buffer, CONTROL_MESSAGE_HEADER_SIZE - 1), 0u);
+    EXPECT_EQ(EncodeControlMessage(abort, buffer, CONTROL_MESSAGE_HEADER_SIZE), (size_t)CONTROL_MESSAGE_HEADER_SIZE);
+    // Escaped JSON text would need decoding first
+    std::string escaped = R"(line\nbreak)";
+    ControlMessage stt;
+    stt.type = kControlStt;
+    stt.text = JsonValue(kJsonString, escaped.data(), escaped.size(), true);
+    std::vector<uint8_t> large(256);
+    EXPECT_EQ(EncodeControlMessage(stt, large.data(), large.size()), 0u);
+}
+
+TEST(ControlMessage, OversizedText) {
+    std::string text(70000, 'a');
+    auto message = MakeMessage(kControlStt, 0, 0, text);
+
+    // One byte short of the whole text is refused, never truncated
+    std::vector<uint8_t> buffer(CONTROL_MESSAGE_HEADER_SIZE + text.size());
+    EXPECT_EQ(EncodeControlMessage(message, buffer.data(), buffer.size() - 1), 0u);
+
+    // The codec itself has no length field; the transports cap a frame at UINT16_MAX
+    size_t size = EncodeControlMessage(message, buffer.data(), buffer.size());
+    ASSERT_EQ(size, buffer.size());
+    EXPECT_GT(size, (size_t)UINT16_MAX);
+    ControlMessage decoded;
+    ASSERT_TRUE(DecodeControlMessage(buffer.data(), size, decoded));
+    EXPECT_EQ(decoded.text.length(), text.size());
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "main_task_queue.h"
+
+namespace {
+
+void RunAll(MainTaskQueue& queue) {
+    while (queue.RunNext()) {
+    }
+}
+
+}  // namespace
+
+TEST(MainTaskQueue, HigherClassesRunFirst) {
+    MainTaskQueue queue(4);
+    std::string order;
+    queue.Push([&order]() { order += "u1 "; }, kMainTaskUi);
+    queue.Push([&order]() { order += "a1 "; }, kMainTaskAudio);
+    queue.Push([&order]() { order += "c1 "; }, kMainTaskControl);
+    queue.Push([&order]() { order += "u2 "; }, kMainTaskUi);
+    queue.Push([&order]() { order += "c2 "; }, kMainTaskControl);
+    RunAll(queue);
+    EXPECT_EQ(order, "c1 c2 a1 u1 u2 ");
+    // Five tasks in four slots
+    EXPECT_EQ(queue.GetStats().overflows, 1u);
+    EXPECT_EQ(queue.Size(), 0u);
+}
+
+TEST(MainTaskQueue, AfterQueuedWaitsForOlderTasks) {
+    MainTaskQueue queue(8);
+    std::string order;
+    // A chat message, then the channel closes and clears it
+    queue.Push([&order]() { order += "chat "; }, kMainTaskUi);
+    queue.Push([&order]() { order += "uplink "; }, kMainTaskAudio);
+    queue.Push([&order]() { order += "emotion "; }, kMainTaskUi);
+    queue.Push([&order]() { order += "close "; }, kMainTaskControl, 0, kMainTaskAfterQueued);
+    queue.Push([&order]() { order += "late "; }, kMainTaskUi);
+    queue.Push([&order]() { order += "abort "; }, kMainTaskControl);
+    RunAll(queue);
+    EXPECT_EQ(order, "chat uplink emotion close abort late ");
+}
+
+TEST(MainTaskQueue, OvertakingControlTaskIsNotHeldBack) {
+    MainTaskQueue queue(8);
+    std::string order;
+    queue.Push([&order]() { order += "chat "; }, kMainTaskUi);
+    queue.Push([&order]() { order += "abort "; }, kMainTaskControl);
+    queue.Push([&order]() { order += "idle "; }, kMainTaskControl, 0, kMainTaskAfterQueued);
+    RunAll(queue);
+    // The idle task waits for the chat message only, the abort still runs first
+    EXPECT_EQ(order, "abort chat idle ");
+}
+
+TEST(MainTaskQueue, TasksScheduledWhileRunningKeepTheirOrder) {
+    MainTaskQueue queue(2);
+    std::vector<int> order;
+    queue.Push([&]() {
+        order.push_back(1);
+        queue.Push([&order]() { order.push_back(3); }, kMainTaskUi);
+        queue.Push([&order]() { order.push_back(4); }, kMainTaskControl, 0, kMainTaskAfterQueued);
+    }, kMainTaskControl);
+    queue.Push([&order]() { order.push_back(2); }, kMainTaskUi);
+    RunAll(queue);
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3, 4}));
+}
+
+TEST(MainTaskQueue, LargeCallablesFallBackToTheHeap) {
+    MainTaskQueue queue(2);
+    std::string text(100, 'x');
+    std::string seen;
+    char large[MainTask::kInlineSize * 2] = {};
+    queue.Push([&seen, text]() { seen = text; }, kMainTaskUi);
+    queue.Push([&seen, large]() { seen += large[0] == 0 ? "!" : "?"; }, kMainTaskUi);
+    RunAll(queue);
+    EXPECT_EQ(seen, text + "!");
+    EXPECT_EQ(queue.GetStats().heap_tasks, 1u);
+}
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_pool.h"
+#include "spsc_ring.h"
+
+namespace {
+
+/* Counts live instances, so discarded and popped items can be checked for leaks */
+struct Item {
+    static std::atomic<int> live;
+    uint32_t value;
+    Item() : Item(0) {}
+    explicit Item(uint32_t value) : value(value) { live++; }
+    ~Item() { live--; }
+};
+std::atomic<int> Item::live = 0;
+
+/* Blocks like the audio tasks do: sleep on the task notification until the peer makes progress */
+template <typename T, size_t N>
+void PushBlocking(SpscRing<T, N>& ring, T&& item) {
+    while (!ring.Push(std::move(item))) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+template <typename T, size_t N>
+void PopBlocking(SpscRing<T, N>& ring, T& item) {
+    while (!ring.Pop(item)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+}  // namespace
+
+TEST(SpscRing, KeepsFifoOrderUpToCapacity) {
+    SpscRing<int, 4> ring;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(ring.Push(int(i)));
+    }
+    EXPECT_FALSE(ring.Push(4));
+    EXPECT_EQ(ring.Size(), 4u);
+
+    int value;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(ring.Pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(ring.Pop(value));
+    EXPECT_TRUE(ring.Empty());
+}
+
+TEST(SpscRing, FailedPushLeavesTheItemWithTheCaller) {
+    SpscRing<std::unique_ptr<Item>, 2> ring;
+    ASSERT_TRUE(ring.Push(std::make_unique<Item>(0)));
+    ASSERT_TRUE(ring.Push(std::make_unique<Item>(1)));
+
+    auto item = std::make_unique<Item>(2);
+    EXPECT_FALSE(ring.Push(std::move(item)));
+    ASSERT_NE(item, nullptr);
+    EXPECT_EQ(item->value, 2u);
+}
+
+TEST(SpscRing, ClearDiscardsEverythingPushedBefore) {
+    {
+        SpscRing<std::unique_ptr<Item>, 8> ring;
+        for (uint32_t i = 0; i < 3; i++) {
+            ASSERT_TRUE(ring.Push(std::make_unique<Item>(i)));
+        }
+        ring.Clear();
+        EXPECT_EQ(ring.Size(), 0u);
+        ASSERT_TRUE(ring.Push(std::make_unique<Item>(10)));
+        EXPECT_EQ(ring.Size(), 1u);
+
+        std::unique_ptr<Item> item;
+        ASSERT_TRUE(ring.Pop(item));
+        EXPECT_EQ(item->value, 10u);
+        EXPECT_FALSE(ring.Pop(item));
+        item.reset();
+        // The discarded items are released by the consumer's Pop
+        EXPECT_EQ(Item::live.load(), 0);
+    }
+    EXPECT_EQ(Item::live.load(), 0);
+}
+
+TEST(SpscRing, ClearHandsDiscardedItemsToTheReleaser) {
+    FramePool<Item> pool(4);
+    std::vector<Item*> pooled;
+    for (int i = 0; i < 3; i++) {
+        pooled.push_back(new Item(i));
+        pool.Release(std::unique_ptr<Item>(pooled.back()));
+    }
+    {
+        SpscRing<std::unique_ptr<Item>, 8> ring(pool.Releaser());
+        for (int i = 0; i < 3; i++) {
+            ASSERT_TRUE(ring.Push(pool.Acquire()));
+        }
+        EXPECT_EQ(pool.GetStats().free, 0u);
+        ring.Clear();
+
+        std::unique_ptr<Item> item;
+        EXPECT_FALSE(ring.Pop(item));
+        // The same objects are back in the pool, none was destroyed
+        EXPECT_EQ(pool.GetStats().free, 3u);
+        EXPECT_EQ(Item::live.load(), 3);
+    }
+    for (int i = 0; i < 3; i++) {
+        auto item = pool.Acquire();
+        EXPECT_NE(std::find(pooled.begin(), pooled.end(), item.get()), pooled.end());
+        pool.Release(std::move(item));
+    }
+    EXPECT_EQ(pool.GetStats().misses, 0u);
+}
+
+TEST(SpscRing, StressBlockingProducerAndConsumer) {
+    constexpr uint32_t kItems = 1000000;
+    SpscRing<uint32_t, 8> ring;
+
+    std::thread consumer([&]() {
+        ring.SetConsumerTask(xTaskGetCurrentTaskHandle());
+        for (uint32_t expected = 0; expected < kItems; expected++) {
+            uint32_t value;
+            PopBlocking(ring, value);
+            ASSERT_EQ(value, expected);
+        }
+        ring.SetConsumerTask(nullptr);
+    });
+    std::thread producer([&]() {
+        ring.SetProducerTask(xTaskGetCurrentTaskHandle());
+        for (uint32_t i = 0; i < kItems; i++) {
+            PushBlocking(ring, uint32_t(i));
+        }
+        ring.SetProducerTask(nullptr);
+    });
+    producer.join();
+    consumer.join();
+    EXPECT_TRUE(ring.Empty());
+}
+
+TEST(SpscRing, StressClearFromAThirdTask) {
+    constexpr uint32_t kItems = 200000;
+    constexpr uint32_t kEnd = UINT32_MAX;
+    std::atomic<bool> producer_done = false;
+    std::atomic<bool> clearing_done = false;
+    std::atomic<uint32_t> received = 0;
+    {
+        SpscRing<std::unique_ptr<Item>, 16> ring;
+
+        std::thread consumer([&]() {
+            ring.SetConsumerTask(xTaskGetCurrentTaskHandle());
+            int64_t last = -1;
+            while (true) {
+                std::unique_ptr<Item> item;
+                PopBlocking(ring, item);
+                if (item->value == kEnd) {
+                    break;
+                }
+                // Clear() may drop items, but never reorders or repeats them
+                ASSERT_GT((int64_t)item->value, last);
+                last = item->value;
+                received++;
+            }
+            ring.SetConsumerTask(nullptr);
+        });
+        std::thread clearer([&]() {
+            while (!producer_done) {
+                ring.Clear();
+                std::this_thread::yield();
+            }
+            clearing_done = true;
+        });
+        std::thread producer([&]() {
+            ring.SetProducerTask(xTaskGetCurrentTaskHandle());
+            for (uint32_t i = 0; i < kItems; i++) {
+                PushBlocking(ring, std::make_unique<Item>(i));
+            }
+            producer_done = true;
+            while (!clearing_done) {
+                std::this_thread::yield();
+            }
+            PushBlocking(ring, std::make_unique<Item>(kEnd));
+            ring.SetProducerTask(nullptr);
+        });
+        producer.join();
+        clearer.join();
+        consumer.join();
+        EXPECT_LE(received.load(), kItems);
+    }
+    EXPECT_EQ(Item::live.load(), 0);
+}
+
+TEST(SpscRing, ProducersSerializedByAMutex) {
+    // The encode and decode queues have several producers that take turns on a mutex
+    constexpr uint32_t kItemsPerProducer = 100000;
+    constexpr int kProducers = 3;
+    SpscRing<uint32_t, 4> ring;
+    std::mutex producer_mutex;
+
+    std::thread consumer([&]() {
+        ring.SetConsumerTask(xTaskGetCurrentTaskHandle());
+        uint32_t next[kProducers] = {};
+        for (uint32_t n = 0; n < kItemsPerProducer * kProducers; n++) {
+            uint32_t value;
+            PopBlocking(ring, value);
+            uint32_t producer = value >> 24;
+            ASSERT_LT(producer, (uint32_t)kProducers);
+            ASSERT_EQ(value & 0xffffff, next[producer]);
+            next[producer]++;
+        }
+        ring.SetConsumerTask(nullptr);
+    });
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&, p]() {
+            for (uint32_t i = 0; i < kItemsPerProducer; i++) {
+                std::lock_guard<std::mutex> lock(producer_mutex);
+                if (ring.Size() >= ring.capacity()) {
+                    ring.SetProducerTask(xTaskGetCurrentTaskHandle());
+                    PushBlocking(ring, ((uint32_t)p << 24) | i);
+                    ring.SetProducerTask(nullptr);
+                } else {
+                    ASSERT_TRUE(ring.Push(((uint32_t)p << 24) | i));
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    consumer.join();
+    EXPECT_TRUE(ring.Empty());
+}
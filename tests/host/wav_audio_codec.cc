@@ -0,0 +1,145 @@
+#include "wav_audio_codec.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+WavAudioCodec::WavAudioCodec(std::vector<int16_t> input, int input_sample_rate, int input_channels,
+    int output_sample_rate, bool realtime) : input_(std::move(input)), realtime_(realtime) {
+    duplex_ = true;
+    input_reference_ = input_channels == 2;
+    input_sample_rate_ = input_sample_rate;
+    input_channels_ = input_channels;
+    output_sample_rate_ = output_sample_rate;
+    output_channels_ = 1;
+}
+
+void WavAudioCodec::Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    cv_.notify_all();
+}
+
+bool WavAudioCodec::input_done() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return input_position_ >= input_.size();
+}
+
+size_t WavAudioCodec::output_samples() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return output_.size();
+}
+
+bool WavAudioCodec::WaitForOutput(size_t samples, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, samples]() {
+        return output_.size() >= samples;
+    });
+}
+
+int WavAudioCodec::Read(int16_t* dest, int samples) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (input_position_ >= input_.size()) {
+        cv_.wait(lock, [this]() { return closed_; });
+        memset(dest, 0, samples * sizeof(int16_t));
+        return samples;
+    }
+    if (start_time_us_ == 0) {
+        start_time_us_ = esp_timer_get_time();
+    }
+    size_t count = std::min((size_t)samples, input_.size() - input_position_);
+    memcpy(dest, input_.data() + input_position_, count * sizeof(int16_t));
+    memset(dest + count, 0, (samples - count) * sizeof(int16_t));
+    input_position_ += count;
+
+    if (realtime_) {
+        // Like I2S, the samples are there once the last one of them has been captured
+        int64_t due_us = start_time_us_ + (int64_t)(input_position_ / input_channels_) * 1000000 / input_sample_rate_;
+        lock.unlock();
+        int64_t wait_us = due_us - esp_timer_get_time();
+        if (wait_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+        }
+    }
+    return samples;
+}
+
+int WavAudioCodec::Write(const int16_t* data, int samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_.insert(output_.end(), data, data + samples);
+    cv_.notify_all();
+    return samples;
+}
+
+struct WavHeader {
+    char riff[4];
+    uint32_t riff_size;
+    char wave[4];
+    char fmt[4];
+    uint32_t fmt_size;
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+};
+
+bool ReadWavFile(const std::string& path, std::vector<int16_t>& samples, int& sample_rate, int& channels) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    WavHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.riff, "RIFF", 4) == 0 &&
+        memcmp(header.wave, "WAVE", 4) == 0 && header.format == 1 && header.bits_per_sample == 16 &&
+        header.channels >= 1 && header.channels <= 2;
+    if (ok) {
+        // Skip the rest of the fmt chunk and any chunk before the samples
+        fseek(file, 12 + 8 + header.fmt_size, SEEK_SET);
+        char id[4];
+        uint32_t size;
+        ok = false;
+        while (fread(id, 4, 1, file) == 1 && fread(&size, 4, 1, file) == 1) {
+            if (memcmp(id, "data", 4) == 0) {
+                samples.resize(size / sizeof(int16_t));
+                ok = fread(samples.data(), sizeof(int16_t), samples.size(), file) == samples.size();
+                break;
+            }
+            fseek(file, size + (size & 1), SEEK_CUR);
+        }
+    }
+    fclose(file);
+    sample_rate = header.sample_rate;
+    channels = header.channels;
+    return ok;
+}
+
+bool WriteWavFile(const std::string& path, const std::vector<int16_t>& samples, int sample_rate, int channels) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    uint32_t data_size = samples.size() * sizeof(int16_t);
+    WavHeader header;
+    memcpy(header.riff, "RIFF", 4);
+    header.riff_size = 36 + data_size;
+    memcpy(header.wave, "WAVE", 4);
+    memcpy(header.fmt, "fmt ", 4);
+    header.fmt_size = 16;
+    header.format = 1;
+    header.channels = channels;
+    header.sample_rate = sample_rate;
+    header.byte_rate = sample_rate * channels * sizeof(int16_t);
+    header.block_align = channels * sizeof(int16_t);
+    header.bits_per_sample = 16;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite("data", 4, 1, file) == 1 &&
+        fwrite(&data_size, 4, 1, file) == 1 &&
+        fwrite(samples.data(), sizeof(int16_t), samples.size(), file) == samples.size();
+    fclose(file);
+    return ok;
+}
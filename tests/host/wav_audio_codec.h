@@ -0,0 +1,48 @@
+#ifndef WAV_AUDIO_CODEC_H
+#define WAV_AUDIO_CODEC_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "audio_codec.h"
+
+/*
+ * AudioCodec that records from a PCM buffer (e.g. a WAV file) and plays into another one, in
+ * place of the I2S codecs. The input is delivered as fast as the audio input task reads it, or
+ * paced at its sample rate with `realtime`. Once it is used up, Read() blocks until Close().
+ */
+class WavAudioCodec : public AudioCodec {
+public:
+    WavAudioCodec(std::vector<int16_t> input, int input_sample_rate, int input_channels, int output_sample_rate,
+        bool realtime);
+
+    /* Releases a Read() blocked at the end of the input, it returns silence from then on */
+    void Close();
+    bool input_done();
+    size_t output_samples();
+    /* Waits until `samples` have been played or `timeout_ms` has passed */
+    bool WaitForOutput(size_t samples, int timeout_ms);
+    const std::vector<int16_t>& output() const { return output_; }
+
+private:
+    std::vector<int16_t> input_;
+    size_t input_position_ = 0;
+    std::vector<int16_t> output_;
+    bool realtime_;
+    bool closed_ = false;
+    int64_t start_time_us_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    int Read(int16_t* dest, int samples) override;
+    int Write(const int16_t* data, int samples) override;
+};
+
+/* 16-bit PCM WAV files, returns false if the file is missing or in another format */
+bool ReadWavFile(const std::string& path, std::vector<int16_t>& samples, int& sample_rate, int& channels);
+bool WriteWavFile(const std::string& path, const std::vector<int16_t>& samples, int sample_rate, int channels);
+
+#endif // WAV_AUDIO_CODEC_H